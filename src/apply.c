@@ -28,6 +28,9 @@
 #include "prepend.h"
 #include "preview.h"
 #include "styles.h"
+#include "read-file.h"
+#include "copyright.h"
+#include "git-years.h"
 
 static struct argp_option argp_options[] = 
 {
@@ -36,6 +39,8 @@ static struct argp_option argp_options[] =
     {"quiet", 'q', NULL, 0, N_("don't show diagnostic messages")},
     {"after", 'a', NULL, 0,
       N_("prepend after existing boilerplate if any")},
+    {"git-years", 'g', NULL, 0,
+      N_("use the years that each file was committed in")},
     {0}
 };
 
@@ -50,6 +55,9 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case 'a':
       opt->after = 1;
       break;
+    case 'g':
+      opt->git_years = 1;
+      break;
     case 'q':
       opt->quiet = 1;
       break;
@@ -66,6 +74,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
       opt->quiet = 0;
       opt->style = NULL;
       opt->after = 0;
+      opt->git_years = 0;
       state->child_inputs[0] = &opt->style;
       break;
     case ARGP_KEY_FINI:
@@ -118,21 +127,27 @@ lu_apply (struct lu_state_t *state, struct lu_apply_options_t *options)
   if (!can_apply(apply.name))
     return -1;
 
-  char boilerplate[sizeof(PACKAGE) + 13];
-  snprintf (boilerplate, sizeof boilerplate, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp (boilerplate);
-  close (fd);
-  FILE *fp = fopen (boilerplate, "w");
-  if (!fp)
-    {
-      remove (boilerplate);
-      return -2;
-    }
   struct lu_preview_options_t preview_options;
   memset (&preview_options, 0, sizeof (preview_options));
   preview_options.state = state;
-  err = generate_boilerplate (state, &preview_options, fp);
-  fclose (fp);
+  char *boilerplate = get_boilerplate_file (state, &preview_options);
+  if (!boilerplate)
+    return -2;
+
+  char *data = NULL;
+  struct lu_git_years_t *git_years = NULL;
+  if (options->git_years)
+    {
+      FILE *fp = fopen (boilerplate, "r");
+      if (fp)
+        {
+          size_t data_len = 0;
+          data = fread_file (fp, &data_len);
+          fclose (fp);
+        }
+      git_years = lu_git_years_new (options->input_files, 
+                                    options->input_files_len);
+    }
 
   char *f = NULL;
   while ((f = argz_next (options->input_files, options->input_files_len, f)))
@@ -159,8 +174,18 @@ lu_apply (struct lu_state_t *state, struct lu_apply_options_t *options)
       prepend_options.after = options->after;
       prepend_options.style = options->style;
       prepend_options.source = boilerplate;
+      prepend_options.source_data = NULL;
       prepend_options.dest = f;
+      if (data)
+        {
+          int years[COPYRIGHT_MAX_YEARS];
+          memset (years, 0, sizeof (years));
+          if (lu_git_years_lookup (git_years, f, years))
+            prepend_options.source_data = 
+              update_copyright_years (data, years, 1, 0);
+        }
       err = lu_prepend (state, &prepend_options);
+      free (prepend_options.source_data);
       if (!err)
         {
           if (options->quiet == 0)
@@ -169,7 +194,10 @@ lu_apply (struct lu_state_t *state, struct lu_apply_options_t *options)
       if (err)
         break;
     }
-  remove (boilerplate);
+  if (git_years)
+    lu_git_years_free (git_years);
+  free (data);
+  free_boilerplate_file (boilerplate);
   return err;
 }
 
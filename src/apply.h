@@ -31,6 +31,7 @@ struct lu_apply_options_t
   int quiet;
   struct lu_comment_style_t *style;
   int after;
+  int git_years;
 };
 
 int lu_apply_parse_argp (struct lu_state_t *, int argc, char **argv);
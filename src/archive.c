@@ -0,0 +1,523 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <zlib.h>
+#include "licensing_priv.h"
+#include "archive.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "stats.h"
+
+static int
+has_suffix (const char *file, const char *suffix)
+{
+  size_t len = strlen (file);
+  size_t suffix_len = strlen (suffix);
+  return len > suffix_len &&
+    strcasecmp (&file[len - suffix_len], suffix) == 0;
+}
+
+static const char *tar_suffixes[] =
+{
+  ".tar", ".tar.gz", ".tgz", NULL
+};
+
+static const char *xz_suffixes[] =
+{
+  ".tar.xz", ".txz", NULL
+};
+
+static int
+has_one_of_suffixes (const char *file, const char **suffixes)
+{
+  for (const char **suffix = suffixes; *suffix; suffix++)
+    if (has_suffix (file, *suffix))
+      return 1;
+  return 0;
+}
+
+int
+lu_is_an_archive (const char *file)
+{
+  return has_one_of_suffixes (file, tar_suffixes) ||
+    has_one_of_suffixes (file, xz_suffixes) || has_suffix (file, ".zip");
+}
+
+//give FUNC the first LEN bytes of a file in the archive.
+static int
+run_func (lu_archive_func_t func, void *data, char *archive, char *member, char *buf, size_t len)
+{
+  //an empty buffer can't be opened, but a nul reads like an empty file.
+  if (len == 0)
+    buf[len++] = '\0';
+  FILE *fp = NULL;
+#ifdef HAVE_FMEMOPEN
+  fp = fmemopen (buf, len, "r");
+#endif
+  if (!fp)
+    {
+      fp = tmpfile ();
+      lu_stats_add (LU_STATS_TEMP_FILES, 1);
+      if (!fp)
+        return -1;
+      fwrite (buf, 1, len, fp);
+      rewind (fp);
+    }
+  char *name = xasprintf ("%s:%s", archive, member);
+  int err = func (data, name, fp);
+  free (name);
+  fclose (fp);
+  return err;
+}
+
+//tar archives are a series of 512 byte headers, each followed by the
+//contents of a file padded out to 512 bytes.  gzip is undone by zlib,
+//and zlib reads plain tar files as they are.
+
+#define TAR_BLOCK_SIZE 512
+
+static int
+read_fully (gzFile gz, char *buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len)
+    {
+      int n = gzread (gz, &buf[done], len - done);
+      if (n <= 0)
+        break;
+      done += n;
+    }
+  return done;
+}
+
+//move past LEN bytes without keeping them.  compressed archives and pipes
+//can't be seeked, so they're read instead.
+static int
+skip_bytes (gzFile gz, off_t len)
+{
+  if (len == 0)
+    return 0;
+  if (gzseek (gz, len, SEEK_CUR) != -1)
+    return 0;
+  char buf[16384];
+  while (len > 0)
+    {
+      int n = gzread (gz, buf, len < sizeof (buf) ? len : sizeof (buf));
+      if (n <= 0)
+        return -1;
+      len -= n;
+    }
+  return 0;
+}
+
+//tar numbers are octal, or base 256 when the first bit is set.
+static off_t
+get_tar_number (const char *field, size_t len)
+{
+  off_t n = 0;
+  if ((unsigned char) field[0] & 0x80)
+    {
+      n = (unsigned char) field[0] & 0x7f;
+      for (size_t i = 1; i < len; i++)
+        n = (n << 8) | (unsigned char) field[i];
+      return n;
+    }
+  for (size_t i = 0; i < len && field[i]; i++)
+    if (field[i] >= '0' && field[i] <= '7')
+      n = (n * 8) + (field[i] - '0');
+  return n;
+}
+
+static int
+is_a_tar_header (const char *header)
+{
+  off_t checksum = get_tar_number (&header[148], 8);
+  off_t sum = 0;
+  for (int i = 0; i < TAR_BLOCK_SIZE; i++)
+    sum += (i >= 148 && i < 156) ? ' ' : (unsigned char) header[i];
+  return sum == checksum;
+}
+
+//the path=... record in a pax extended header.
+static char *
+get_pax_path (char *records, size_t len)
+{
+  char *path = NULL;
+  char *record = records;
+  while (record < records + len)
+    {
+      char *end = NULL;
+      long int record_len = strtol (record, &end, 10);
+      if (record_len <= 0 || record + record_len > records + len)
+        break;
+      if (strncmp (end, " path=", 6) == 0)
+        {
+          free (path);
+          path = strndup (end + 6, record + record_len - (end + 6) - 1);
+        }
+      record += record_len;
+    }
+  return path;
+}
+
+static char *
+get_tar_name (const char *header)
+{
+  char *name = strndup (header, 100);
+  if (memcmp (&header[257], "ustar", 5) == 0 && header[345])
+    {
+      char *prefix = strndup (&header[345], 155);
+      char *path = xasprintf ("%s/%s", prefix, name);
+      free (prefix);
+      free (name);
+      name = path;
+    }
+  return name;
+}
+
+static int
+is_all_zeroes (const char *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    if (buf[i])
+      return 0;
+  return 1;
+}
+
+static int
+foreach_in_tar (char *file, gzFile gz, lu_archive_func_t func, void *data)
+{
+  int err = 0;
+  char header[TAR_BLOCK_SIZE];
+  char *buf = malloc (LU_ARCHIVE_HEAD_SIZE + 1);
+  char *long_name = NULL;
+  int entries = 0;
+  while (1)
+    {
+      //the archive ends with a block of zeroes, or for an empty archive,
+      //with nothing at all.
+      int n = read_fully (gz, header, TAR_BLOCK_SIZE);
+      if ((n == 0 && entries == 0) ||
+          (n == TAR_BLOCK_SIZE && is_all_zeroes (header, n)))
+        break;
+      if (n == 0)
+        {
+          error (0, 0, N_("`%s' ends too soon"), file);
+          err = -1;
+          break;
+        }
+      entries++;
+      if (n != TAR_BLOCK_SIZE || !is_a_tar_header (header))
+        {
+          error (0, 0, N_("`%s' is not a tar archive"), file);
+          err = -1;
+          break;
+        }
+      off_t size = get_tar_number (&header[124], 12);
+      off_t padding = (TAR_BLOCK_SIZE - (size % TAR_BLOCK_SIZE)) %
+        TAR_BLOCK_SIZE;
+      char type = header[156];
+      size_t len = size < LU_ARCHIVE_HEAD_SIZE ? size : LU_ARCHIVE_HEAD_SIZE;
+      if (type == '0' || type == '\0' || type == '7' || type == 'L' ||
+          type == 'x')
+        {
+          if (read_fully (gz, buf, len) != len)
+            {
+              error (0, 0, N_("`%s' ends too soon"), file);
+              err = -1;
+              break;
+            }
+        }
+      else
+        len = 0;
+      if (skip_bytes (gz, size - len + padding))
+        {
+          error (0, 0, N_("`%s' ends too soon"), file);
+          err = -1;
+          break;
+        }
+      //gnu tar and pax put long names in their own entries, which go
+      //with the entry that comes after them.
+      if (type == 'L')
+        {
+          free (long_name);
+          long_name = strndup (buf, len);
+        }
+      else if (type == 'x')
+        {
+          char *path = get_pax_path (buf, len);
+          if (path)
+            {
+              free (long_name);
+              long_name = path;
+            }
+        }
+      else
+        {
+          if (type == '0' || type == '\0' || type == '7')
+            {
+              char *name = long_name ? long_name : get_tar_name (header);
+              long_name = NULL;
+              if (run_func (func, data, file, name, buf, len))
+                err = -1;
+              free (name);
+            }
+          else
+            {
+              free (long_name);
+              long_name = NULL;
+            }
+        }
+    }
+  free (long_name);
+  free (buf);
+  return err;
+}
+
+//xz isn't something zlib can undo, so xz is run to undo it for us, and
+//the tar archive is read from the pipe.
+static gzFile
+open_xz (char *file, pid_t *pid)
+{
+  int fd = open (file, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  int fds[2];
+  if (pipe (fds) == -1)
+    {
+      close (fd);
+      return NULL;
+    }
+  lu_stats_add (LU_STATS_SPAWNS, 1);
+  *pid = fork ();
+  if (*pid == 0)
+    {
+      dup2 (fd, STDIN_FILENO);
+      dup2 (fds[1], STDOUT_FILENO);
+      close (fd);
+      close (fds[0]);
+      close (fds[1]);
+      execlp ("xz", "xz", "-dc", (char *) NULL);
+      _exit (127);
+    }
+  close (fd);
+  close (fds[1]);
+  if (*pid == -1)
+    {
+      close (fds[0]);
+      return NULL;
+    }
+  return gzdopen (fds[0], "rb");
+}
+
+static int
+foreach_in_tar_file (char *file, lu_archive_func_t func, void *data)
+{
+  pid_t pid = -1;
+  gzFile gz;
+  if (has_one_of_suffixes (file, xz_suffixes))
+    gz = open_xz (file, &pid);
+  else
+    gz = gzopen (file, "rb");
+  if (!gz)
+    {
+      error (0, errno, N_("could not open `%s' for reading"), file);
+      return -1;
+    }
+  int err = foreach_in_tar (file, gz, func, data);
+  gzclose (gz);
+  if (pid != -1)
+    {
+      int status = 0;
+      waitpid (pid, &status, 0);
+      if (WIFEXITED (status) && WEXITSTATUS (status) == 127)
+        {
+          error (0, 0, N_("could not run xz to read `%s'"), file);
+          err = -1;
+        }
+    }
+  return err;
+}
+
+//zip archives are read from the central directory at the end, which
+//says where each file starts and how it was compressed.
+
+#define ZIP_END_SIGNATURE 0x06054b50
+#define ZIP_END_SIZE 22
+#define ZIP_ENTRY_SIGNATURE 0x02014b50
+#define ZIP_ENTRY_SIZE 46
+#define ZIP_LOCAL_SIGNATURE 0x04034b50
+#define ZIP_LOCAL_SIZE 30
+
+static unsigned int
+get16 (const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static unsigned long
+get32 (const unsigned char *p)
+{
+  return get16 (p) | ((unsigned long) get16 (&p[2]) << 16);
+}
+
+//the end of central directory record is in the last 64k or so, before
+//the archive's comment.
+static int
+find_zip_end (FILE *fp, unsigned char *end)
+{
+  if (fseeko (fp, 0, SEEK_END) != 0)
+    return 0;
+  off_t size = ftello (fp);
+  off_t len = size < 65535 + ZIP_END_SIZE ? size : 65535 + ZIP_END_SIZE;
+  unsigned char *buf = malloc (len);
+  int found = 0;
+  if (fseeko (fp, size - len, SEEK_SET) == 0 && fread (buf, 1, len, fp) == len)
+    for (off_t i = len - ZIP_END_SIZE; i >= 0 && !found; i--)
+      if (get32 (&buf[i]) == ZIP_END_SIGNATURE)
+        {
+          memcpy (end, &buf[i], ZIP_END_SIZE);
+          found = 1;
+        }
+  free (buf);
+  return found;
+}
+
+//read the start of a file that deflate compressed into BUF.
+static size_t
+inflate_head (FILE *fp, unsigned long compressed_size, char *buf, size_t len)
+{
+  z_stream z;
+  memset (&z, 0, sizeof (z));
+  if (inflateInit2 (&z, -MAX_WBITS) != Z_OK)
+    return 0;
+  unsigned char in[16384];
+  z.next_out = (unsigned char *) buf;
+  z.avail_out = len;
+  int ret = Z_OK;
+  while (ret == Z_OK && z.avail_out > 0 && compressed_size > 0)
+    {
+      size_t n = compressed_size < sizeof (in) ? compressed_size : sizeof (in);
+      n = fread (in, 1, n, fp);
+      if (n == 0)
+        break;
+      compressed_size -= n;
+      z.next_in = in;
+      z.avail_in = n;
+      while (ret == Z_OK && z.avail_in > 0 && z.avail_out > 0)
+        ret = inflate (&z, Z_NO_FLUSH);
+    }
+  size_t done = len - z.avail_out;
+  inflateEnd (&z);
+  return done;
+}
+
+static int
+foreach_in_zip_file (char *file, lu_archive_func_t func, void *data)
+{
+  FILE *fp = fopen (file, "rb");
+  if (!fp)
+    {
+      error (0, errno, N_("could not open `%s' for reading"), file);
+      return -1;
+    }
+  unsigned char end[ZIP_END_SIZE];
+  if (!find_zip_end (fp, end))
+    {
+      error (0, 0, N_("`%s' is not a zip archive"), file);
+      fclose (fp);
+      return -1;
+    }
+  unsigned int num_entries = get16 (&end[10]);
+  off_t offset = get32 (&end[16]);
+  int err = 0;
+  char *buf = malloc (LU_ARCHIVE_HEAD_SIZE + 1);
+  for (unsigned int i = 0; i < num_entries; i++)
+    {
+      unsigned char entry[ZIP_ENTRY_SIZE];
+      if (fseeko (fp, offset, SEEK_SET) != 0 ||
+          fread (entry, 1, ZIP_ENTRY_SIZE, fp) != ZIP_ENTRY_SIZE ||
+          get32 (entry) != ZIP_ENTRY_SIGNATURE)
+        {
+          error (0, 0, N_("`%s' is not a zip archive"), file);
+          err = -1;
+          break;
+        }
+      unsigned int flags = get16 (&entry[8]);
+      unsigned int method = get16 (&entry[10]);
+      unsigned long compressed_size = get32 (&entry[20]);
+      unsigned long size = get32 (&entry[24]);
+      unsigned int name_len = get16 (&entry[28]);
+      off_t local = get32 (&entry[42]);
+      char *name = malloc (name_len + 1);
+      if (fread (name, 1, name_len, fp) != name_len)
+        name_len = 0;
+      name[name_len] = '\0';
+      offset += ZIP_ENTRY_SIZE + name_len + get16 (&entry[30]) +
+        get16 (&entry[32]);
+
+      //directories, encrypted files and zip64 files are passed over.
+      if (name_len == 0 || name[name_len - 1] == '/' || (flags & 1) ||
+          size == 0xffffffff || compressed_size == 0xffffffff ||
+          local == 0xffffffff)
+        {
+          free (name);
+          continue;
+        }
+      unsigned char header[ZIP_LOCAL_SIZE];
+      size_t len = size < LU_ARCHIVE_HEAD_SIZE ? size : LU_ARCHIVE_HEAD_SIZE;
+      if (fseeko (fp, local, SEEK_SET) != 0 ||
+          fread (header, 1, ZIP_LOCAL_SIZE, fp) != ZIP_LOCAL_SIZE ||
+          get32 (header) != ZIP_LOCAL_SIGNATURE ||
+          fseeko (fp, get16 (&header[26]) + get16 (&header[28]),
+                  SEEK_CUR) != 0)
+        len = 0;
+      else if (method == 0)
+        len = fread (buf, 1, len, fp);
+      else if (method == 8)
+        len = inflate_head (fp, compressed_size, buf, len);
+      else
+        {
+          error (0, 0, N_("`%s' in `%s' is compressed in a way that "
+                          "can't be read"), name, file);
+          free (name);
+          continue;
+        }
+      if (run_func (func, data, file, name, buf, len))
+        err = -1;
+      free (name);
+    }
+  free (buf);
+  fclose (fp);
+  return err;
+}
+
+int
+lu_archive_foreach (char *file, lu_archive_func_t func, void *data)
+{
+  if (has_suffix (file, ".zip"))
+    return foreach_in_zip_file (file, func, data);
+  return foreach_in_tar_file (file, func, data);
+}
@@ -0,0 +1,39 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_ARCHIVE_H
+#define LU_ARCHIVE_H 1
+
+#include <config.h>
+#include <stdio.h>
+
+//how much of each file in an archive is read.  the comments at the top
+//of a file have to fit in here to be found.
+#define LU_ARCHIVE_HEAD_SIZE (64 * 1024)
+
+//FP has the start of a file in an archive, and NAME is the archive and
+//the name of the file in it, separated by a colon.
+typedef int (*lu_archive_func_t) (void *data, char *name, FILE *fp);
+
+//1 when FILE ends in .tar, .tar.gz, .tgz, .tar.xz, .txz or .zip.
+int lu_is_an_archive (const char *file);
+
+//run FUNC on each of the regular files in the archive FILE, without
+//extracting them.  only the start of each file is read, and the rest is
+//skipped.  .tar.xz files are read with xz.
+int lu_archive_foreach (char *file, lu_archive_func_t func, void *data);
+#endif
@@ -0,0 +1,150 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <glib.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (1024 * 1024)
+#define ARENA_ALIGN (sizeof (void *) * 2)
+
+struct lu_arena_block_t
+{
+  struct lu_arena_block_t *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+struct lu_arena_t
+{
+  struct lu_arena_block_t *blocks; //the one being filled comes first
+  size_t total;
+};
+
+static struct lu_arena_block_t *
+new_block (size_t size)
+{
+  struct lu_arena_block_t *block =
+    malloc (sizeof (struct lu_arena_block_t) + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+static void
+free_blocks (struct lu_arena_block_t *block)
+{
+  while (block)
+    {
+      struct lu_arena_block_t *next = block->next;
+      free (block);
+      block = next;
+    }
+}
+
+static void
+free_arena (gpointer data)
+{
+  struct lu_arena_t *arena = data;
+  free_blocks (arena->blocks);
+  free (arena);
+}
+
+static GPrivate arena_key = G_PRIVATE_INIT (free_arena);
+
+struct lu_arena_t *
+lu_arena_get ()
+{
+  struct lu_arena_t *arena = g_private_get (&arena_key);
+  if (!arena)
+    {
+      arena = calloc (1, sizeof (struct lu_arena_t));
+      g_private_set (&arena_key, arena);
+    }
+  return arena;
+}
+
+void *
+lu_arena_alloc (struct lu_arena_t *arena, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  struct lu_arena_block_t *block = arena->blocks;
+  if (!block || block->size - block->used < size)
+    {
+      block = new_block (size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+      block->next = arena->blocks;
+      arena->blocks = block;
+    }
+  void *ptr = &block->data[block->used];
+  block->used += size;
+  arena->total += size;
+  return ptr;
+}
+
+char *
+lu_arena_strndup (struct lu_arena_t *arena, const char *s, size_t n)
+{
+  char *copy = lu_arena_alloc (arena, n + 1);
+  memcpy (copy, s, n);
+  copy[n] = '\0';
+  return copy;
+}
+
+char *
+lu_arena_printf (struct lu_arena_t *arena, const char *fmt, ...)
+{
+  va_list ap;
+  va_start (ap, fmt);
+  int len = vsnprintf (NULL, 0, fmt, ap);
+  va_end (ap);
+  if (len < 0)
+    len = 0;
+  char *s = lu_arena_alloc (arena, len + 1);
+  s[0] = '\0';
+  va_start (ap, fmt);
+  vsnprintf (s, len + 1, fmt, ap);
+  va_end (ap);
+  return s;
+}
+
+void
+lu_arena_reset (struct lu_arena_t *arena)
+{
+  struct lu_arena_block_t *block = arena->blocks;
+  if (!block)
+    return;
+  //when the last file didn't fit in one block, make one that it fits in,
+  //so that a run of similar files settles down to a single block.
+  if (block->next || block->size > ARENA_MAX_BLOCK_SIZE)
+    {
+      size_t size = arena->total;
+      if (size < ARENA_BLOCK_SIZE || size > ARENA_MAX_BLOCK_SIZE)
+        size = ARENA_BLOCK_SIZE;
+      free_blocks (block);
+      block = new_block (size);
+    }
+  block->used = 0;
+  arena->blocks = block;
+  arena->total = 0;
+}
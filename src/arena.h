@@ -0,0 +1,37 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_ARENA_H
+#define LU_ARENA_H 1
+
+#include <config.h>
+#include <stddef.h>
+
+//scratch memory for working on one file.  allocations are never freed
+//one at a time; the whole arena is reset when the file is done.
+struct lu_arena_t;
+
+//each thread has an arena of its own.
+struct lu_arena_t * lu_arena_get ();
+
+void * lu_arena_alloc (struct lu_arena_t *arena, size_t size);
+char * lu_arena_strndup (struct lu_arena_t *arena, const char *s, size_t n);
+char * lu_arena_printf (struct lu_arena_t *arena, const char *fmt, ...);
+
+//forget everything that was allocated, but keep the memory for next time.
+void lu_arena_reset (struct lu_arena_t *arena);
+#endif
@@ -0,0 +1,246 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <argz.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "licensing_priv.h"
+#include "batch.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "arena.h"
+
+static int
+ignore_dot_files (const struct dirent *entry)
+{
+  return entry->d_name[0] != '.';
+}
+
+static int
+has_suffix (const char *file, const char **suffixes)
+{
+  size_t file_len = strlen (file);
+  for (int i = 0; suffixes[i]; i++)
+    {
+      size_t suffix_len = strlen (suffixes[i]);
+      if (file_len >= suffix_len &&
+          strcasecmp (&file[file_len - suffix_len], suffixes[i]) == 0)
+        return 1;
+    }
+  return 0;
+}
+
+static int
+collect_directory (char *dir, const char **suffixes, char **argz, size_t *len)
+{
+  struct dirent **entries = NULL;
+  int n = scandir (dir, &entries, ignore_dot_files, alphasort);
+  if (n < 0)
+    {
+      error (0, errno, N_("could not open `%s' for reading"), dir);
+      return -1;
+    }
+  int err = 0;
+  for (int i = 0; i < n; i++)
+    {
+      char *f = xasprintf ("%s/%s", dir, entries[i]->d_name);
+      struct stat st;
+      //symlinks are skipped, so that we don't go around in circles.
+      if (lstat (f, &st) == 0)
+        {
+          if (S_ISDIR (st.st_mode))
+            err |= collect_directory (f, suffixes, argz, len);
+          else if (S_ISREG (st.st_mode) &&
+                   (!suffixes || has_suffix (f, suffixes)))
+            argz_add (argz, len, f);
+        }
+      free (f);
+      free (entries[i]);
+    }
+  free (entries);
+  return err;
+}
+
+int
+lu_collect_files_with_suffixes (char *file, int recursive, const char **suffixes, char **argz, size_t *len)
+{
+  struct stat st;
+  if (stat (file, &st) != 0)
+    {
+      error (0, errno, N_("could not open `%s' for reading"), file);
+      return -1;
+    }
+  if (S_ISDIR (st.st_mode))
+    {
+      if (recursive)
+        return collect_directory (file, suffixes, argz, len);
+      error (0, EISDIR, "%s", file);
+      return -1;
+    }
+  argz_add (argz, len, file);
+  return 0;
+}
+
+int
+lu_collect_files (char *file, int recursive, char **argz, size_t *len)
+{
+  return lu_collect_files_with_suffixes (file, recursive, NULL, argz, len);
+}
+
+int
+lu_batch_default_jobs ()
+{
+  return g_get_num_processors ();
+}
+
+int
+lu_batch_parse_jobs (char *arg)
+{
+  char *end = NULL;
+  long int jobs = strtol (arg, &end, 10);
+  if (end == arg || *end != '\0' || jobs < 1 || jobs > 1024)
+    return -1;
+  return jobs;
+}
+
+char *
+lu_batch_failure (const char *fmt, const char *file, int errnum)
+{
+  char *msg = xasprintf (fmt, file);
+  char *report = xasprintf ("%s: %s", msg, strerror (errnum));
+  free (msg);
+  return report;
+}
+
+struct lu_batch_t
+{
+  char **files;
+  size_t num_files;
+  int *results;
+  char **outputs;
+  char **reports;
+  int *done;
+  size_t next;
+  lu_batch_func_t func;
+  void *data;
+  GMutex lock;
+  GCond cond;
+};
+
+static gpointer
+batch_worker (gpointer data)
+{
+  struct lu_batch_t *batch = data;
+  while (1)
+    {
+      g_mutex_lock (&batch->lock);
+      size_t i = batch->next++;
+      g_mutex_unlock (&batch->lock);
+      if (i >= batch->num_files)
+        break;
+      char *output = NULL;
+      char *report = NULL;
+      int result = batch->func (batch->data, batch->files[i], &output,
+                                &report);
+      lu_arena_reset (lu_arena_get ());
+      g_mutex_lock (&batch->lock);
+      batch->results[i] = result;
+      batch->outputs[i] = output;
+      batch->reports[i] = report;
+      batch->done[i] = 1;
+      g_cond_broadcast (&batch->cond);
+      g_mutex_unlock (&batch->lock);
+    }
+  return NULL;
+}
+
+static void
+show_report (char *report)
+{
+  if (!report)
+    return;
+  char *line = strtok (report, "\n");
+  while (line)
+    {
+      error (0, 0, "%s", line);
+      line = strtok (NULL, "\n");
+    }
+  free (report);
+}
+
+int
+lu_batch (struct lu_state_t *state, char *argz, size_t len, int jobs, lu_batch_func_t func, void *data)
+{
+  struct lu_batch_t batch;
+  memset (&batch, 0, sizeof (batch));
+  batch.num_files = argz_count (argz, len);
+  if (batch.num_files == 0)
+    return 0;
+  batch.files = malloc (sizeof (char *) * (batch.num_files + 1));
+  argz_extract (argz, len, batch.files);
+  batch.results = calloc (batch.num_files, sizeof (int));
+  batch.outputs = calloc (batch.num_files, sizeof (char *));
+  batch.reports = calloc (batch.num_files, sizeof (char *));
+  batch.done = calloc (batch.num_files, sizeof (int));
+  batch.func = func;
+  batch.data = data;
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.cond);
+
+  if (jobs < 1)
+    jobs = 1;
+  if (jobs > batch.num_files)
+    jobs = batch.num_files;
+  GThread **threads = calloc (jobs, sizeof (GThread *));
+  for (int i = 0; i < jobs; i++)
+    threads[i] = g_thread_new ("batch", batch_worker, &batch);
+
+  int err = 0;
+  for (size_t i = 0; i < batch.num_files; i++)
+    {
+      g_mutex_lock (&batch.lock);
+      while (!batch.done[i])
+        g_cond_wait (&batch.cond, &batch.lock);
+      g_mutex_unlock (&batch.lock);
+      if (batch.outputs[i])
+        {
+          luprintf (state, "%s", batch.outputs[i]);
+          free (batch.outputs[i]);
+        }
+      show_report (batch.reports[i]);
+      if (batch.results[i])
+        err = batch.results[i];
+    }
+
+  for (int i = 0; i < jobs; i++)
+    g_thread_join (threads[i]);
+  free (threads);
+  g_mutex_clear (&batch.lock);
+  g_cond_clear (&batch.cond);
+  free (batch.files);
+  free (batch.results);
+  free (batch.outputs);
+  free (batch.reports);
+  free (batch.done);
+  return err;
+}
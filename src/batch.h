@@ -0,0 +1,47 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_BATCH_H
+#define LU_BATCH_H 1
+
+#include <config.h>
+#include <stddef.h>
+#include "licensing.h"
+
+//work on one file.  put anything for the output into *OUTPUT, and any
+//messages for the user into *REPORT.
+typedef int (*lu_batch_func_t) (void *data, char *file, char **output, char **report);
+
+//add FILE to the argz list, or the files under it when it's a directory.
+int lu_collect_files (char *file, int recursive, char **argz, size_t *len);
+
+//like lu_collect_files, but the files found in directories have to end
+//in one of the SUFFIXES.
+int lu_collect_files_with_suffixes (char *file, int recursive, const char **suffixes, char **argz, size_t *len);
+
+//run FUNC on every file in ARGZ using up to JOBS threads.  the output and
+//reports are shown in the same order as the files, as soon as they're ready.
+int lu_batch (struct lu_state_t *state, char *argz, size_t len, int jobs, lu_batch_func_t func, void *data);
+
+int lu_batch_default_jobs ();
+
+//returns the number of jobs in ARG, or -1 if it isn't one.
+int lu_batch_parse_jobs (char *arg);
+
+//make a report out of FMT, which has a %s for FILE, and the ERRNUM error.
+char * lu_batch_failure (const char *fmt, const char *file, int errnum);
+#endif
@@ -29,6 +29,7 @@
 #include "error.h"
 #include "util.h"
 #include "styles.h"
+#include "archive.h"
 
 enum
 {
@@ -215,18 +216,12 @@ get_max_block (int *blocks)
 }
 
 static int
-show_lu_boilerplate (struct lu_state_t *state, struct lu_boilerplate_options_t *options, char *file)
+show_lu_boilerplate (struct lu_state_t *state, struct lu_boilerplate_options_t *options, FILE *fp, char *file)
 {
   char *comment_blocks = NULL;
   size_t len = 0;
-  FILE *fp = fopen (file, "r");
-  if (!fp)
-    return 0;
-  if (options->style == NULL)
-    auto_detect_comment_blocks (file, fp, &comment_blocks, &len, NULL);
-  else
-    options->style->get_initial_comment (fp, &comment_blocks, &len, NULL);
-  fclose (fp);
+  lu_get_comment_blocks_of_file (options->style, file, fp, &comment_blocks,
+                                 &len);
   if (comment_blocks)
     {
       if (options->blockspec && 
@@ -267,22 +262,22 @@ comments_contain_copyright_notice (char *argz, size_t len)
   return 0;
 }
 
+//when FROM_STDOUT is set, FP is the standard input and the result goes to
+//the standard output instead of replacing FILENAME.
 static int
-remove_lu_boilerplate (struct lu_state_t *state, struct lu_boilerplate_options_t *options, char *filename, int from_stdout)
+remove_lu_boilerplate (struct lu_state_t *state, struct lu_boilerplate_options_t *options, FILE *fp, char *filename, int from_stdout)
 {
   struct stat st;
   char *comment_blocks = NULL;
   size_t len = 0;
   int err = 0;
-  FILE *fp = fopen (filename, "r");
-  if (!fp)
-    return err;
-  fstat (fileno (fp), &st);
+  if (!from_stdout)
+    fstat (fileno (fp), &st);
   char *hashbang = NULL;
   if (options->style == NULL)
     auto_detect_comment_blocks (filename, fp, &comment_blocks, &len, &hashbang);
   else
-    options->style->get_initial_comment (fp, &comment_blocks, &len, &hashbang);
+    lu_get_initial_comment (options->style, fp, &comment_blocks, &len, &hashbang);
   if (comment_blocks == NULL)
     {
       error (0, 0, N_("no boilerplate found in `%s'"), filename);
@@ -343,14 +338,17 @@ remove_lu_boilerplate (struct lu_state_t *state, struct lu_boilerplate_options_t
         {
           ssize_t read = getline (&line, &linelen, fp);
           if (read != -1 && strspn (line, "\n\r\t\v ") != strlen (line))
-            fprintf (out, "%s", line);
+            fwrite (line, 1, read, out);
           if (read != -1)
-            while ((read = getline (&line, &linelen, fp)) != -1) 
-              fprintf (out, "%s", line);
+            copy_rest_of_file (fp, out);
         }
       free(line);
-      if (!from_stdout)
-        fclose (out);
+    }
+  else
+    err = -1;
+  if (out && !from_stdout)
+    {
+      fclose (out);
       err = chmod (swpfilename, st.st_mode);
       if (err)
         error (0, errno, N_("could not chmod `%s'"), swpfilename);
@@ -368,19 +366,16 @@ remove_lu_boilerplate (struct lu_state_t *state, struct lu_boilerplate_options_t
                        filename);
             }
         }
-      if (from_stdout || options->no_backups)
+      if (options->no_backups)
         {
           err = remove (bakfilename);
           if (err)
             error (0, errno, N_("could not remove `%s'"), bakfilename);
         }
     }
-  else
-    err = -1;
   free (swpfilename);
   free (bakfilename);
   free (comment_blocks);
-  fclose (fp);
   return err;
 }
 
@@ -388,35 +383,33 @@ static int
 boilerplate_from_stdin (struct lu_state_t *state, struct lu_boilerplate_options_t *options)
 {
   int err = 0;
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fileptr = fopen (tmp, "w");
-  if (fileptr)
+  FILE *fp = open_stdin_copy ();
+  if (fp)
     {
-      char *line = NULL;
-      size_t len = 0;
-      ssize_t read;
-
-      while ((read = getline(&line, &len, stdin)) != -1)
-        fprintf (fileptr, "%s", line);
-
-      free (line);
-      fflush (fileptr);
-      fsync (fileno (fileptr));
-      fclose (fileptr);
       if (options->remove)
-        err = remove_lu_boilerplate (state, options, tmp, 1);
+        err = remove_lu_boilerplate (state, options, fp, "-", 1);
       else
-        err = show_lu_boilerplate (state, options, tmp);
-      remove (tmp);
+        err = show_lu_boilerplate (state, options, fp, "-");
+      fclose (fp);
     }
   else
     err = -1;
   return err;
 }
 
+struct boilerplate_archive_t
+{
+  struct lu_state_t *state;
+  struct lu_boilerplate_options_t *options;
+};
+
+static int
+show_lu_boilerplate_in_member (void *data, char *name, FILE *fp)
+{
+  struct boilerplate_archive_t *archive = data;
+  return show_lu_boilerplate (archive->state, archive->options, fp, name);
+}
+
 static int
 show_lu_boilerplate_for_files(struct lu_state_t *state, struct lu_boilerplate_options_t *options)
 {
@@ -439,6 +432,18 @@ show_lu_boilerplate_for_files(struct lu_state_t *state, struct lu_boilerplate_op
                 }
               continue;
             }
+          if (lu_is_an_archive (f))
+            {
+              struct boilerplate_archive_t archive = { state, options };
+              if (options->remove)
+                error (0, 0,
+                       N_("can't remove boilerplate from the files in `%s'"),
+                       f);
+              else
+                lu_archive_foreach (f, show_lu_boilerplate_in_member,
+                                    &archive);
+              continue;
+            }
           if (options->remove)
             {
               if (access (f, W_OK) != 0)
@@ -448,10 +453,15 @@ show_lu_boilerplate_for_files(struct lu_state_t *state, struct lu_boilerplate_op
 
                   continue;
                 }
-              err = remove_lu_boilerplate (state, options, f, 0);
             }
+          FILE *fp = fopen (f, "r");
+          if (!fp)
+            continue;
+          if (options->remove)
+            err = remove_lu_boilerplate (state, options, fp, f, 0);
           else
-            err = show_lu_boilerplate (state, options, f);
+            err = show_lu_boilerplate (state, options, fp, f);
+          fclose (fp);
         }
       if (err)
         break;
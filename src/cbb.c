@@ -25,6 +25,7 @@
 #include "error.h"
 #include "util.h"
 #include "styles.h"
+#include "archive.h"
 
 static struct argp_option argp_options[] = 
 {
@@ -143,11 +144,35 @@ show_results (struct lu_state_t *state, struct lu_cbb_options_t *options, char *
   luprintf (state, "%s%s\n", file ? " ": "", file ? file : "");
 }
 
-static int
-count_boilerplate_blocks (struct lu_state_t *state, struct lu_cbb_options_t *options, char *file, int showfile)
+static void
+count_boilerplate_blocks_in_stream (struct lu_state_t *state, struct lu_cbb_options_t *options, FILE *fp, char *file, int showfile)
 {
   char *comment_blocks = NULL;
   size_t len = 0;
+  lu_get_comment_blocks_of_file (options->style, file, fp, &comment_blocks,
+                                 &len);
+  show_results (state, options, comment_blocks, len, showfile ? file: NULL);
+  free (comment_blocks);
+}
+
+struct cbb_archive_t
+{
+  struct lu_state_t *state;
+  struct lu_cbb_options_t *options;
+};
+
+static int
+count_boilerplate_blocks_in_member (void *data, char *name, FILE *fp)
+{
+  struct cbb_archive_t *archive = data;
+  count_boilerplate_blocks_in_stream (archive->state, archive->options, fp,
+                                      name, 1);
+  return 0;
+}
+
+static int
+count_boilerplate_blocks (struct lu_state_t *state, struct lu_cbb_options_t *options, char *file, int showfile)
+{
   if (is_a_file (file) == 0)
     {
       if (errno == EISDIR)
@@ -156,46 +181,29 @@ count_boilerplate_blocks (struct lu_state_t *state, struct lu_cbb_options_t *opt
         error (0, errno, N_("could not open `%s' for reading"), file);
       return 0;
     }
+  if (lu_is_an_archive (file))
+    {
+      struct cbb_archive_t archive = { state, options };
+      lu_archive_foreach (file, count_boilerplate_blocks_in_member, &archive);
+      return 0;
+    }
   FILE *fp = fopen (file, "r");
   if (!fp)
     return 0;
-  if (options->style == NULL)
-    auto_detect_comment_blocks (file, fp, &comment_blocks, &len, NULL);
-  else
-    options->style->get_initial_comment (fp, &comment_blocks, &len, NULL);
+  count_boilerplate_blocks_in_stream (state, options, fp, file, showfile);
   fclose (fp);
-  show_results (state, options, comment_blocks, len, showfile ? file: NULL);
   return 0;
 }
 
 static int 
 lu_cbb_from_stdin (struct lu_state_t *state, struct lu_cbb_options_t *options)
 {
-  int err = 0;
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fileptr = fopen (tmp, "w");
-  if (fileptr)
-    {
-      char *line = NULL;
-      size_t len = 0;
-      ssize_t read;
-
-      while ((read = getline(&line, &len, stdin)) != -1)
-        fprintf (fileptr, "%s", line);
-
-      free (line);
-      fflush (fileptr);
-      fsync (fileno (fileptr));
-      fclose (fileptr);
-      err = count_boilerplate_blocks (state, options, tmp, 0);
-      remove (tmp);
-    }
-  else
-    err = -1;
-  return err;
+  FILE *fp = open_stdin_copy ();
+  if (!fp)
+    return -1;
+  count_boilerplate_blocks_in_stream (state, options, fp, "-", 0);
+  fclose (fp);
+  return 0;
 }
 
 int 
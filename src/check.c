@@ -0,0 +1,325 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <argz.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "licensing_priv.h"
+#include "check.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "read-file.h"
+#include "util.h"
+#include "preview.h"
+#include "batch.h"
+#include "scan-cache.h"
+#include "stats.h"
+#include "archive.h"
+
+static struct argp_option argp_options[] =
+{
+    {"jobs", 'j', "NUM", 0, N_("work on NUM files at a time")},
+    {0}
+};
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  struct lu_check_options_t *opt = NULL;
+  if (state)
+    opt = (struct lu_check_options_t*) state->input;
+  switch (key)
+    {
+    case 'j':
+      opt->jobs = lu_batch_parse_jobs (arg);
+      if (opt->jobs == -1)
+        {
+          argp_failure (state, 0, 0,
+                        N_("`%s' is an invalid number of jobs"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    case ARGP_KEY_ARG:
+      argz_add (&opt->input_files, &opt->input_files_len, arg);
+      break;
+    case ARGP_KEY_INIT:
+      opt->input_files = NULL;
+      opt->input_files_len = 0;
+      opt->jobs = lu_batch_default_jobs ();
+      break;
+    case ARGP_KEY_FINI:
+      if (opt->input_files == NULL)
+        {
+          argp_failure (state, 0, 0, N_("no files specified"));
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
+#undef CHECK_DOC
+#define CHECK_DOC \
+  N_("Show the files that don't start with the current working boilerplate.") "\v"\
+  N_("Each FILE has to start with the boilerplate that the apply command would put there, after a #! line if there is one.") "  "\
+  N_("Differences in whitespace don't count.") "  "\
+  N_("Directories are looked in recursively.") "  "\
+  N_("The exit status is 1 when any of the files are shown.")
+static struct argp argp = { argp_options, parse_opt, "FILE...", CHECK_DOC};
+
+int
+lu_check_parse_argp (struct lu_state_t *state, int argc, char **argv)
+{
+  int err = 0;
+  struct lu_check_options_t opts;
+  opts.state = state;
+
+  err = argp_parse (&argp, argc, argv, state->argp_flags,  0, &opts);
+  if (!err)
+    return lu_check (state, &opts);
+  else
+    return err;
+}
+
+struct check_t
+{
+  //the boilerplate, with every run of whitespace made into one space.
+  char *expected;
+  size_t expected_len;
+  //what the results are kept as in the scan cache, which changes along
+  //with the boilerplate.
+  char *kind;
+  gint checked;
+  gint failed;
+};
+
+static char *
+normalize (char *text)
+{
+  char *result = malloc (strlen (text) + 1);
+  size_t i = 0;
+  int space = 0;
+  for (char *c = text; *c; c++)
+    {
+      if (isspace ((unsigned char) *c))
+        {
+          space = i > 0;
+          continue;
+        }
+      if (space)
+        result[i++] = ' ';
+      space = 0;
+      result[i++] = *c;
+    }
+  result[i] = '\0';
+  return result;
+}
+
+//read FP only as far as it's the same as the boilerplate.
+static int
+starts_with_boilerplate (struct check_t *check, FILE *fp)
+{
+  size_t bytes = 0;
+  int c = getc (fp);
+  if (c == '#')
+    {
+      bytes++;
+      c = getc (fp);
+      if (c == '!')
+        {
+          while (c != EOF && c != '\n')
+            {
+              bytes++;
+              c = getc (fp);
+            }
+        }
+      else
+        {
+          rewind (fp);
+          bytes = 0;
+        }
+      c = getc (fp);
+    }
+  size_t i = 0;
+  int space = 1;
+  for (; i < check->expected_len && c != EOF; c = getc (fp))
+    {
+      bytes++;
+      if (isspace (c))
+        {
+          if (space)
+            continue;
+          space = 1;
+          if (check->expected[i] != ' ')
+            break;
+        }
+      else
+        {
+          space = 0;
+          if (check->expected[i] != c)
+            break;
+        }
+      i++;
+    }
+  lu_stats_add (LU_STATS_FILES_READ, 1);
+  lu_stats_add (LU_STATS_BYTES_READ, bytes);
+  return i == check->expected_len;
+}
+
+//the files in an archive that don't start with the boilerplate are
+//added to OUTPUT.
+struct check_archive_t
+{
+  struct check_t *check;
+  char *output;
+};
+
+static int
+check_member (void *data, char *name, FILE *fp)
+{
+  struct check_archive_t *archive = data;
+  g_atomic_int_add (&archive->check->checked, 1);
+  if (starts_with_boilerplate (archive->check, fp))
+    return 0;
+  char *output = xasprintf ("%s%s\n", archive->output ? archive->output : "",
+                            name);
+  free (archive->output);
+  archive->output = output;
+  g_atomic_int_add (&archive->check->failed, 1);
+  return 0;
+}
+
+static int
+check_file (void *data, char *file, char **output, char **report)
+{
+  struct check_t *check = data;
+  if (lu_is_an_archive (file))
+    {
+      struct check_archive_t archive = { check, NULL };
+      int err = lu_archive_foreach (file, check_member, &archive);
+      *output = archive.output;
+      return err ? -1 : archive.output != NULL;
+    }
+  g_atomic_int_add (&check->checked, 1);
+  FILE *fp = fopen (file, "r");
+  if (!fp)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for reading"), file,
+                                  errno);
+      return -1;
+    }
+  struct stat st;
+  fstat (fileno (fp), &st);
+  char *saved = NULL;
+  size_t saved_len = 0;
+  int ok;
+  if (lu_scan_cache_lookup (check->kind, file, &st, &saved, &saved_len))
+    ok = saved != NULL;
+  else
+    {
+      ok = starts_with_boilerplate (check, fp);
+      lu_scan_cache_store (check->kind, file, &st, ok ? "ok" : NULL,
+                           ok ? 2 : 0);
+    }
+  free (saved);
+  fclose (fp);
+  if (ok)
+    return 0;
+  *output = xasprintf ("%s\n", file);
+  g_atomic_int_add (&check->failed, 1);
+  return 1;
+}
+
+int
+lu_check (struct lu_state_t *state, struct lu_check_options_t *options)
+{
+  int err = 0;
+  if (!can_apply (check.name))
+    {
+      free (options->input_files);
+      return -1;
+    }
+
+  struct lu_preview_options_t preview_options;
+  memset (&preview_options, 0, sizeof (preview_options));
+  preview_options.state = state;
+  char *boilerplate = get_boilerplate_file (state, &preview_options);
+  if (!boilerplate)
+    {
+      free (options->input_files);
+      return -2;
+    }
+  struct check_t c;
+  memset (&c, 0, sizeof (c));
+  FILE *fp = fopen (boilerplate, "r");
+  if (fp)
+    {
+      size_t len = 0;
+      char *text = fread_file (fp, &len);
+      fclose (fp);
+      if (text)
+        {
+          c.expected = normalize (text);
+          c.expected_len = strlen (c.expected);
+          free (text);
+        }
+    }
+  if (!c.expected)
+    {
+      error (0, errno, N_("could not open `%s' for reading"), boilerplate);
+      free_boilerplate_file (boilerplate);
+      free (options->input_files);
+      return -2;
+    }
+  c.kind = xasprintf ("check-%s", strrchr (boilerplate, '/') + 1);
+
+  char *files = NULL;
+  size_t files_len = 0;
+  char *f = NULL;
+  while ((f = argz_next (options->input_files, options->input_files_len, f)))
+    if (lu_collect_files (f, 1, &files, &files_len))
+      err = -1;
+  if (lu_batch (state, files, files_len, options->jobs, check_file, &c))
+    err = 1;
+  if (c.failed)
+    error (0, 0, N_("%d of %d files don't start with the boilerplate"),
+           c.failed, c.checked);
+
+  free (c.expected);
+  free (c.kind);
+  free_boilerplate_file (boilerplate);
+  free (files);
+  free (options->input_files);
+  return err;
+}
+
+struct lu_command_t check =
+{
+  .name         = N_("check"),
+  .doc          = CHECK_DOC,
+  .flags        = SHOW_IN_HELP | SAVE_IN_HISTORY,
+  .argp         = &argp,
+  .parser       = lu_check_parse_argp
+};
@@ -1,4 +1,4 @@
-/*  Copyright (C) 2013 Ben Asselstine
+/*  Copyright (C) 2016 Ben Asselstine
 
   This program is free software; you can redistribute it and/or modify
   it under the terms of the GNU General Public License as published by
@@ -15,9 +15,22 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
   02110-1301, USA.
 */
-#ifndef LU_GETTEXT_STYLE_H
-#define LU_GETTEXT_STYLE_H 1
-#include "comment-style.h"
-extern struct lu_comment_style_t gettext_style;
-extern struct argp gettext_style_argp;
+#ifndef LU_CHECK_H
+#define LU_CHECK_H 1
+
+#include <config.h>
+#include <argp.h>
+#include "licensing.h"
+
+struct lu_check_options_t
+{
+  struct lu_state_t *state;
+  char *input_files;
+  size_t input_files_len;
+  int jobs;
+};
+
+int lu_check_parse_argp (struct lu_state_t *, int argc, char **argv);
+int lu_check (struct lu_state_t *, struct lu_check_options_t *);
+extern struct lu_command_t check;
 #endif
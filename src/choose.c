@@ -30,6 +30,7 @@
 #include "error.h"
 #include "copy-file.h"
 #include "styles.h"
+#include "stats.h"
 
 static struct argp_option argp_options[] = 
 {
@@ -326,6 +327,7 @@ write_selected_licenses (struct lu_state_t *state, struct lu_choose_options_t *o
       snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
       int fd = mkstemp(tmp);
       close (fd);
+      lu_stats_add (LU_STATS_TEMP_FILES, 1);
       FILE *fp = fopen (tmp, "w");
       if (fp)
         {
@@ -0,0 +1,245 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include "classify.h"
+#include "styles.h"
+#include "c-ctype.h"
+
+//how much of the start of a file we look at.
+#define HEAD_SIZE 4096
+//vim looks for modelines in the first 5 lines.
+#define MODELINE_LINES 5
+
+struct name_to_style_t
+{
+  const char *name;
+  const char *style;
+};
+
+//the interpreters of #! lines, without their version numbers.
+static const struct name_to_style_t interpreters[] =
+{
+    { "sh", "shell" }, { "bash", "shell" }, { "dash", "shell" },
+    { "ksh", "shell" }, { "zsh", "shell" }, { "csh", "shell" },
+    { "tcsh", "shell" }, { "fish", "shell" }, { "make", "shell" },
+    { "awk", "shell" }, { "gawk", "shell" }, { "sed", "shell" },
+    { "python", "python" }, { "perl", "perl" }, { "ruby", "ruby" },
+    { "lua", "lua" }, { "guile", "scheme" }, { "racket", "scheme" },
+    { "runhaskell", "haskell" }, { "runghc", "haskell" },
+    { "node", "javascript" }, { "nodejs", "javascript" },
+    { "escript", "erlang" }, { "ocaml", "ocaml" }, { "emacs", "lisp" },
+    { "sbcl", "lisp" }, { "clisp", "lisp" },
+    { NULL, NULL },
+};
+
+//the modes of emacs modelines and the filetypes of vim modelines.
+static const struct name_to_style_t modes[] =
+{
+    { "c", "c" }, { "c++", "c++" }, { "cpp", "c++" },
+    { "javascript", "javascript" }, { "js", "javascript" },
+    { "sh", "shell" }, { "shell-script", "shell" }, { "bash", "shell" },
+    { "zsh", "shell" }, { "makefile", "shell" }, { "make", "shell" },
+    { "scheme", "scheme" }, { "texinfo", "texinfo" }, { "m4", "m4" },
+    { "autoconf", "m4" }, { "haskell", "haskell" }, { "nroff", "groff" },
+    { "groff", "groff" }, { "po", "gettext" }, { "fortran", "fortran" },
+    { "f90", "fortran" }, { "pascal", "pascal" }, { "python", "python" },
+    { "perl", "perl" }, { "cperl", "perl" }, { "ruby", "ruby" },
+    { "lua", "lua" }, { "sql", "sql" }, { "xml", "xml" }, { "nxml", "xml" },
+    { "css", "css" }, { "rust", "rust" }, { "tex", "tex" },
+    { "latex", "tex" }, { "plaintex", "tex" }, { "lisp", "lisp" },
+    { "emacs-lisp", "lisp" }, { "common-lisp", "lisp" },
+    { "erlang", "erlang" }, { "ocaml", "ocaml" }, { "tuareg", "ocaml" },
+    { "vim", "vim" },
+    { NULL, NULL },
+};
+
+//NAME is LEN characters long, and when VERSIONED it can end in a
+//version number like python3 or perl5.36.
+static struct lu_comment_style_t *
+lookup_name (const struct name_to_style_t *names, const char *name, size_t len, int versioned)
+{
+  for (; names->name; names++)
+    {
+      size_t n = strlen (names->name);
+      if (n > len || strncasecmp (names->name, name, n) != 0)
+        continue;
+      size_t i = n;
+      if (versioned)
+        while (i < len && (c_isdigit (name[i]) || name[i] == '.'))
+          i++;
+      if (i == len)
+        return lu_lookup_comment_style ((char *) names->style);
+    }
+  return NULL;
+}
+
+static size_t
+word_length (const char *s, const char *end, const char *stops)
+{
+  const char *p = s;
+  while (p < end && !c_isspace (*p) && !strchr (stops, *p))
+    p++;
+  return p - s;
+}
+
+static const char *
+skip_blanks (const char *s, const char *end)
+{
+  while (s < end && (*s == ' ' || *s == '\t'))
+    s++;
+  return s;
+}
+
+//#!/bin/sh, #!/usr/bin/env python3, #! /usr/bin/perl -w
+static struct lu_comment_style_t *
+classify_hashbang (const char *line, const char *end)
+{
+  const char *p = skip_blanks (line + 2, end);
+  size_t len = word_length (p, end, "");
+  //just the program's name, not its directory.
+  for (size_t i = len; i > 0; i--)
+    if (p[i - 1] == '/')
+      {
+        p += i;
+        len -= i;
+        break;
+      }
+  if (len == 3 && strncmp (p, "env", 3) == 0)
+    {
+      p = skip_blanks (p + len, end);
+      //env -S and friends.
+      while (p < end && *p == '-')
+        p = skip_blanks (p + word_length (p, end, ""), end);
+      len = word_length (p, end, "");
+    }
+  return lookup_name (interpreters, p, len, 1);
+}
+
+//-*- mode: c -*-, or -*- c -*-, or -*- coding: utf-8; mode: c -*-
+static struct lu_comment_style_t *
+classify_emacs_modeline (const char *line, const char *end)
+{
+  const char *start = memmem (line, end - line, "-*-", 3);
+  if (!start)
+    return NULL;
+  start += 3;
+  const char *stop = memmem (start, end - start, "-*-", 3);
+  if (!stop)
+    return NULL;
+  const char *mode = memmem (start, stop - start, "mode:", 5);
+  if (mode && (mode == start || !c_isalnum (mode[-1])))
+    mode = skip_blanks (mode + 5, stop);
+  else if (!memchr (start, ':', stop - start))
+    mode = skip_blanks (start, stop);
+  else
+    return NULL;
+  return lookup_name (modes, mode, word_length (mode, stop, ";"), 0);
+}
+
+//vim: set ft=c :, or vi: filetype=c
+static struct lu_comment_style_t *
+classify_vim_modeline (const char *line, const char *end)
+{
+  const char *p = line;
+  while ((p = memmem (p, end - p, "vi", 2)))
+    {
+      const char *q = p + 2;
+      if (q < end && *q == 'm')
+        q++;
+      if ((p == line || c_isspace (p[-1])) && q < end && *q == ':')
+        {
+          const char *ft = NULL;
+          for (const char *r = q; r < end && !ft; r++)
+            {
+              if ((r == q || !c_isalnum (r[-1])) && end - r > 3 &&
+                  strncmp (r, "ft=", 3) == 0)
+                ft = r + 3;
+              else if ((r == q || !c_isalnum (r[-1])) && end - r > 9 &&
+                       strncmp (r, "filetype=", 9) == 0)
+                ft = r + 9;
+            }
+          if (ft)
+            return lookup_name (modes, ft, word_length (ft, end, ":"), 0);
+        }
+      p += 2;
+    }
+  return NULL;
+}
+
+static int
+starts_with (const char *s, const char *end, const char *prefix)
+{
+  size_t len = strlen (prefix);
+  return end - s >= len && strncmp (s, prefix, len) == 0;
+}
+
+//the syntax of some comments can't be mistaken for another style.
+static struct lu_comment_style_t *
+classify_first_characters (const char *s, const char *end)
+{
+  const char *style = NULL;
+  if (starts_with (s, end, "<?xml") || starts_with (s, end, "<!--"))
+    style = "xml";
+  else if (starts_with (s, end, "\\input texinfo") ||
+           starts_with (s, end, "@c ") || starts_with (s, end, "@comment "))
+    style = "texinfo";
+  else if ((starts_with (s, end, "dnl") || starts_with (s, end, "DNL")) &&
+           (end - s == 3 || c_isspace (s[3])))
+    style = "m4";
+  else if (starts_with (s, end, ".\\\"") || starts_with (s, end, "'\\\"") ||
+           starts_with (s, end, ".\\#"))
+    style = "groff";
+  else if (starts_with (s, end, "{-"))
+    style = "haskell";
+  //a .po file without a .po extension.
+  else if (starts_with (s, end, "# ") && memmem (s, end - s, "\nmsgid ", 7))
+    style = "gettext";
+  return style ? lu_lookup_comment_style ((char *) style) : NULL;
+}
+
+struct lu_comment_style_t *
+lu_classify_comment_style (char *data, size_t len)
+{
+  const char *end = data + (len < HEAD_SIZE ? len : HEAD_SIZE);
+  struct lu_comment_style_t *style = NULL;
+  const char *line = data;
+  for (int i = 0; i < MODELINE_LINES && line < end && !style; i++)
+    {
+      const char *eol = memchr (line, '\n', end - line);
+      if (!eol)
+        eol = end;
+      if (i == 0 && starts_with (line, eol, "#!"))
+        style = classify_hashbang (line, eol);
+      //emacs only looks at the first line, or the second one after a #!.
+      if (!style && (i == 0 || (i == 1 && starts_with (data, end, "#!"))))
+        style = classify_emacs_modeline (line, eol);
+      if (!style)
+        style = classify_vim_modeline (line, eol);
+      line = eol + 1;
+    }
+  if (!style)
+    {
+      const char *s = data;
+      while (s < end && c_isspace (*s))
+        s++;
+      style = classify_first_characters (s, end);
+    }
+  return style;
+}
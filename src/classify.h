@@ -1,4 +1,4 @@
-/*  Copyright (C) 2013 Ben Asselstine
+/*  Copyright (C) 2016 Ben Asselstine
 
   This program is free software; you can redistribute it and/or modify
   it under the terms of the GNU General Public License as published by
@@ -15,9 +15,15 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
   02110-1301, USA.
 */
-#ifndef LU_CPLUSPLUS_STYLE_H
-#define LU_CPLUSPLUS_STYLE_H 1
+#ifndef LU_CLASSIFY_H
+#define LU_CLASSIFY_H 1
+
+#include <config.h>
+#include <stddef.h>
 #include "comment-style.h"
-extern struct lu_comment_style_t cplusplus_style;
-extern struct argp cplusplus_style_argp;
+
+//the commenting style that the start of DATA says it's in, going by a #!
+//line, an emacs or vim modeline, or the first characters of the file.
+//NULL when it doesn't say, and the styles have to be tried one by one.
+struct lu_comment_style_t * lu_classify_comment_style (char *data, size_t len);
 #endif
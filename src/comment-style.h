@@ -21,15 +21,49 @@
 #include <config.h>
 #include <stdio.h>
 #include <argp.h>
+#include <glib.h>
+
+//one pass of uncomment_comments over a comment.
+struct lu_uncomment_rule_t
+{
+  char *delimiters;
+  char *synonymous_delimiter;
+  int first_literal;
+  int second_literal;
+};
+
+enum lu_comment_style_flags_t
+{
+  LU_STYLE_HIDDEN = 1,       //only shown by --help-all-styles
+  LU_STYLE_LINES_APART = 2,  //every line comment is a comment block of its own
+  LU_STYLE_CASELESS = 4,     //the line comment prefixes can be in any case
+};
+
+//a commenting style is nothing but a description of its syntax.  the
+//comments are found, made and taken apart by the code in styles.c.
 struct lu_comment_style_t
 {
   const char *name;
-  const struct argp *argp;
-  int (*get_initial_comment) (FILE *fp, char **argz, size_t *len, char **hash);
-  char* (*comment) (char *text);
-  void (*uncomment) (char **argz, size_t *argz_len, int trim);
+  int key;                        //the option that picks this style
+  int flags;
+  const char *doc;
+  //the comments we make: block comments when CLOSE is set, otherwise
+  //OPEN goes at the start of every line.
+  char *open;
+  char *close;
+  //the comments we find at the top of a file: pairs of block
+  //delimiters separated by spaces, and line comment prefixes separated
+  //by bars.  a prefix that ends in a letter has to be followed by a
+  //space or the end of the line.
+  char *blocks;
+  char *lines;
+  //a first line starting with this stays before the comments, like #!.
+  char *first_line;
+  struct lu_uncomment_rule_t uncomment[2];
   char *support_file_exts;
   char *avoid_file_exts;
+  //made out of BLOCKS and LINES by lu_init_comment_styles.
+  GRegex *regex;
 };
 
 #endif
@@ -24,11 +24,11 @@
 #include "comment.h"
 #include "gettext-more.h"
 #include "xvasprintf.h"
-#include "read-file.h"
 #include "error.h"
 #include "util.h"
 
 #include "styles.h"
+#include "arena.h"
 
 static error_t 
 parse_arg (int key, char *arg, struct argp_state *state)
@@ -85,70 +85,52 @@ char *
 lu_create_comment (struct lu_state_t *state, struct lu_comment_options_t *options, char *text)
 {
   if (options->style)
-    return options->style->comment (text);
+    return lu_comment_in_style (options->style, text);
 
   struct lu_comment_style_t *default_style = get_default_commenting_style();
   if (default_style)
-    return default_style->comment(text);
+    return lu_comment_in_style (default_style, text);
 
   return strdup (text);
 }
 
 static int
-create_comment_from_file (struct lu_state_t *state, struct lu_comment_options_t *options, char *filename)
+create_comment_from_stream (struct lu_state_t *state, struct lu_comment_options_t *options, FILE *fp)
 {
-  FILE *fp = fopen (filename, "r");
-  if (!fp)
-    return -1;
   size_t data_len = 0;
-  char *data = fread_file (fp, &data_len);
+  int more = 0;
+  char *data = lu_read_head (fp, &data_len, &more);
+  if (!data)
+    return -1;
+  if (more)
+    {
+      error (0, 0, N_("the standard input is bigger than the memory budget"));
+      free (data);
+      return -1;
+    }
   char *comment = lu_create_comment (state, options, data);
   luprintf (state, "%s", comment);
   free (comment);
   free (data);
-  fclose (fp);
+  lu_arena_reset (lu_arena_get ());
   return 0;
 }
 
 static int
 lu_comment_from_stdin (struct lu_state_t *state, struct lu_comment_options_t*options)
 {
-  int err = 0;
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fileptr = fopen (tmp, "w");
-  if (fileptr)
-    {
-      char *line = NULL;
-      size_t len = 0;
-      ssize_t read;
-
-      while ((read = getline(&line, &len, stdin)) != -1)
-        fprintf (fileptr, "%s", line);
-
-      free (line);
-      fflush (fileptr);
-      fsync (fileno (fileptr));
-      fclose (fileptr);
-      err = create_comment_from_file (state, options, tmp);
-      remove (tmp);
-    }
-  else
-    err = -1;
-  return err;
+  return create_comment_from_stream (state, options, stdin);
 }
 
 static int
 create_comment_from_files (struct lu_state_t *state, struct lu_comment_options_t *options)
 {
   int err = 0;
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *out = fopen (tmp, "w");
+  char *text = NULL;
+  size_t text_len = 0;
+  FILE *out = open_memstream (&text, &text_len);
+  if (!out)
+    return -1;
   char *f = NULL;
   while ((f = argz_next (options->input_files, options->input_files_len, f)))
     {
@@ -168,16 +150,38 @@ create_comment_from_files (struct lu_state_t *state, struct lu_comment_options_t
       if (fp)
         {
           size_t data_len = 0;
-          char *data = fread_file (fp, &data_len);
-          fprintf (out, "%s", data);
+          int more = 0;
+          char *data = lu_read_head (fp, &data_len, &more);
+          if (more)
+            {
+              error (0, 0, N_("`%s' is bigger than the memory budget"), f);
+              err = -1;
+            }
+          else if (data)
+            fprintf (out, "%s", data);
           free (data);
           if (fp != stdin)
             fclose (fp);
+          if (err)
+            break;
+        }
+      //the comment is made out of all of the files together.
+      if ((size_t) ftello (out) > lu_get_memory_budget ())
+        {
+          error (0, 0, N_("the files are bigger than the memory budget"));
+          err = -1;
+          break;
         }
     }
   fclose (out);
-  err = create_comment_from_file (state, options, tmp);
-  remove (tmp);
+  if (!err)
+    {
+      char *comment = lu_create_comment (state, options, text);
+      luprintf (state, "%s", comment);
+      free (comment);
+    }
+  free (text);
+  lu_arena_reset (lu_arena_get ());
   return err;
 }
 
@@ -186,7 +190,7 @@ lu_comment (struct lu_state_t *state, struct lu_comment_options_t *options)
 {
   int err = 0;
   if (options->input_files == NULL)
-    lu_comment_from_stdin (state, options);
+    err = lu_comment_from_stdin (state, options);
   else
     err = create_comment_from_files(state, options);
   free (options->input_files);
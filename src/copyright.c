@@ -28,6 +28,7 @@
 #include "xvasprintf.h"
 #include "read-file.h"
 #include "trim.h"
+#include "c-ctype.h"
 
 static struct argp_option argp_options[] = 
 {
@@ -46,7 +47,7 @@ static struct argp_option argp_options[] =
     {0}
 };
 
-static int
+int
 get_current_year()
 {
   struct tm tm;
@@ -55,7 +56,7 @@ get_current_year()
   return tm.tm_year + 1900;
 }
 
-static int 
+int 
 parse_yearspec (char *yearspec, int *years)
 {
   int err = 0;
@@ -407,11 +408,11 @@ lu_copyright_parse_argp (struct lu_state_t *state, int argc, char **argv)
 }
 
 static int 
-add_copyright_years (char **argz, size_t *len, struct lu_copyright_options_t *options)
+add_copyright_years (char **argz, size_t *len, int *years)
 {
   for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
     {
-      if (options->years[i])
+      if (years[i])
         {
           char *year = xasprintf (" %d", i + 1900);
           argz_add (argz, len, year);
@@ -422,17 +423,17 @@ add_copyright_years (char **argz, size_t *len, struct lu_copyright_options_t *op
 }
 
 static int 
-add_copyright_years_abbreviated (char **argz, size_t *len, struct lu_copyright_options_t *options)
+add_copyright_years_abbreviated (char **argz, size_t *len, int *years)
 {
   int i = 0;
   while (i < COPYRIGHT_MAX_YEARS)
     {
-      while (options->years[i] == 0 && i < COPYRIGHT_MAX_YEARS)
+      while (i < COPYRIGHT_MAX_YEARS && years[i] == 0)
         i++;
       if (i < COPYRIGHT_MAX_YEARS)
         {
           int start = i;
-          while (options->years[i] == 1 && i < COPYRIGHT_MAX_YEARS)
+          while (i < COPYRIGHT_MAX_YEARS && years[i] == 1)
             i++;
           int end = i-1;
           if (start == end)
@@ -452,6 +453,249 @@ add_copyright_years_abbreviated (char **argz, size_t *len, struct lu_copyright_o
   return 0;
 }
 
+char *
+format_copyright_years (int *years, int abbreviate)
+{
+  char *argz = NULL;
+  size_t len = 0;
+  if (abbreviate == 0)
+    add_copyright_years (&argz, &len, years);
+  else
+    add_copyright_years_abbreviated (&argz, &len, years);
+  if (argz == NULL)
+    return strdup ("");
+  argz_stringify(argz, len, ',');
+  return argz;
+}
+
+static const char *
+find_copyright (const char *line, const char *eol)
+{
+  static const char word[] = "copyright";
+  for (const char *p = line; p + sizeof (word) - 1 <= eol; p++)
+    {
+      size_t i = 0;
+      while (i < sizeof (word) - 1 && c_tolower (p[i]) == word[i])
+        i++;
+      if (i == sizeof (word) - 1)
+        return p + i;
+    }
+  return NULL;
+}
+
+//put the years of a line like `Copyright (C) 2013, 2015 Ben' into START
+//and END.
+static int
+find_copyright_years (const char *line, const char *eol, const char **start, const char **end)
+{
+  const char *p = find_copyright (line, eol);
+  if (!p)
+    return 0;
+  while (p < eol && (*p == ' ' || *p == '\t'))
+    p++;
+  if (eol - p >= 3 &&
+      (strncmp (p, "(C)", 3) == 0 || strncmp (p, "(c)", 3) == 0))
+    p += 3;
+  else if (eol - p >= 2 && strncmp (p, "©", 2) == 0)
+    p += 2;
+  while (p < eol && (*p == ' ' || *p == '\t'))
+    p++;
+  *start = p;
+  *end = NULL;
+  //a run of digits is only a year when it isn't the start of a word, like
+  //the holder in `Copyright (C) 2013 2ndQuadrant'.
+  while (p < eol && c_isdigit (*p))
+    {
+      const char *q = p;
+      while (q < eol && c_isdigit (*q))
+        q++;
+      if (q < eol && (c_isalnum (*q) || *q == '_'))
+        break;
+      *end = q;
+      while (q < eol && strchr (",- \t", *q))
+        q++;
+      p = q;
+    }
+  return *end != NULL;
+}
+
+//turn `2013, 2014 - 2016' into `2013,2014-2016' so parse_yearspec likes it.
+static char *
+normalize_years (const char *start, const char *end)
+{
+  char *spec = malloc (end - start + 1);
+  char *s = spec;
+  for (const char *p = start; p < end; p++)
+    {
+      if (c_isdigit (*p))
+        *s++ = *p;
+      else if (*p == ',' || *p == '-')
+        {
+          if (s > spec && c_isdigit (s[-1]))
+            *s++ = *p;
+        }
+      else if (s > spec && c_isdigit (s[-1]))
+        {
+          const char *next = p;
+          while (next < end && (*next == ' ' || *next == '\t'))
+            next++;
+          if (next < end && c_isdigit (*next))
+            *s++ = ',';
+        }
+    }
+  *s = '\0';
+  return spec;
+}
+
+//put the years in ADD into `2013,2014' where they go, separated in the
+//same way as the years already there, so that the text that's there
+//stays as it is.
+static char *
+add_years_to_text (const char *start, const char *end, int *years, int *add, int abbreviate)
+{
+  const char *sep = ", ";
+  size_t sep_len = 2;
+  const char *comma = memchr (start, ',', end - start);
+  if (comma)
+    {
+      sep = comma;
+      sep_len = 1;
+      while (comma + sep_len < end &&
+             (comma[sep_len] == ' ' || comma[sep_len] == '\t'))
+        sep_len++;
+    }
+  char *text = xasprintf ("%.*s", (int) (end - start), start);
+  for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
+    {
+      if (!add[i] || years[i])
+        continue;
+      //find the last year in the text that comes before this one.
+      size_t at = 0, after = 0;
+      int before = -1, ends_range = 0;
+      for (size_t p = 0; text[p]; )
+        {
+          if (!c_isdigit (text[p]))
+            {
+              p++;
+              continue;
+            }
+          size_t q = p;
+          while (c_isdigit (text[q]))
+            q++;
+          int year = atoi (text + p) - 1900;
+          if (year >= i)
+            break;
+          size_t b = p;
+          while (b > 0 && (text[b - 1] == ' ' || text[b - 1] == '\t'))
+            b--;
+          before = year;
+          ends_range = b > 0 && text[b - 1] == '-';
+          at = p;
+          after = q;
+          p = q;
+        }
+      char *longer;
+      if (before == -1)
+        longer = xasprintf ("%d%.*s%s", i + 1900, (int) sep_len, sep, text);
+      else if (abbreviate && i == before + 1 && ends_range)
+        //2010-2014 becomes 2010-2015.
+        longer = xasprintf ("%.*s%d%s", (int) at, text, i + 1900,
+                            text + after);
+      else if (abbreviate && i == before + 1)
+        longer = xasprintf ("%.*s-%d%s", (int) after, text, i + 1900,
+                            text + after);
+      else
+        longer = xasprintf ("%.*s%.*s%d%s", (int) after, text,
+                            (int) sep_len, sep, i + 1900, text + after);
+      free (text);
+      text = longer;
+      years[i] = 1;
+    }
+  return text;
+}
+
+static char *
+update_copyright_line (const char *line, const char *eol, int *add, int replace, int abbreviate)
+{
+  const char *start = NULL, *end = NULL;
+  if (!find_copyright_years (line, eol, &start, &end))
+    return NULL;
+  int years[COPYRIGHT_MAX_YEARS];
+  memset (years, 0, sizeof (years));
+  char *spec = normalize_years (start, end);
+  int err = parse_yearspec (spec, years);
+  free (spec);
+  if (err)
+    return NULL;
+  if (memchr (start, '-', end - start))
+    abbreviate = 1;
+  if (!replace)
+    {
+      int missing = 0;
+      for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
+        if (add[i] && !years[i])
+          missing = 1;
+      if (!missing)
+        return NULL;
+      char *added = add_years_to_text (start, end, years, add, abbreviate);
+      char *updated = xasprintf ("%.*s%s%.*s", (int) (start - line), line,
+                                 added, (int) (eol - end), end);
+      free (added);
+      return updated;
+    }
+  int changed = 0, count = 0;
+  for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
+    {
+      int year = add[i] || (!replace && years[i]);
+      if (year != years[i])
+        changed = 1;
+      years[i] = year;
+      count += year;
+    }
+  if (!changed || count == 0)
+    return NULL;
+  char *formatted = format_copyright_years (years, abbreviate);
+  char *updated = xasprintf ("%.*s%s%.*s", (int) (start - line), line,
+                             formatted + 1, (int) (eol - end), end);
+  free (formatted);
+  return updated;
+}
+
+char *
+update_copyright_years (const char *text, int *add, int replace, int abbreviate)
+{
+  int changed = 0;
+  char *argz = NULL;
+  size_t len = 0;
+  const char *line = text;
+  while (*line)
+    {
+      const char *eol = strchr (line, '\n');
+      if (!eol)
+        eol = line + strlen (line);
+      char *updated = update_copyright_line (line, eol, add, replace,
+                                              abbreviate);
+      if (updated)
+        changed = 1;
+      else
+        updated = xasprintf ("%.*s", (int) (eol - line), line);
+      argz_add (&argz, &len, updated);
+      free (updated);
+      if (*eol == '\0')
+        break;
+      line = eol + 1;
+    }
+  if (!changed)
+    {
+      free (argz);
+      return NULL;
+    }
+  if (*text && text[strlen (text) - 1] == '\n')
+    argz_add (&argz, &len, "");
+  argz_stringify (argz, len, '\n');
+  return argz;
+}
+
 static void
 get_names (struct lu_state_t *state, char **names, size_t *names_len)
 {
@@ -478,8 +722,6 @@ get_names (struct lu_state_t *state, char **names, size_t *names_len)
 int 
 lu_copyright (struct lu_state_t *state, struct lu_copyright_options_t *options)
 {
-  char *argz = NULL;
-  size_t len = 0;
   char *names = NULL;
   size_t names_len = 0;
   char *file = NULL;
@@ -523,12 +765,8 @@ lu_copyright (struct lu_state_t *state, struct lu_copyright_options_t *options)
   else
     argz_add (&names, &names_len, options->name);
 
-  if (options->abbreviate_years == 0)
-    add_copyright_years (&argz, &len, options);
-  else
-    add_copyright_years_abbreviated (&argz, &len, options);
-
-  argz_stringify(argz, len, ',');
+  char *argz = format_copyright_years (options->years, 
+                                       options->abbreviate_years);
 
   //how many of the names can we fit on a line before reaching say 76 columns?
   int max_width = 76;
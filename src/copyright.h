@@ -44,5 +44,11 @@ struct lu_copyright_options_t
 
 int lu_copyright_parse_argp (struct lu_state_t *, int argc, char **argv);
 int lu_copyright (struct lu_state_t *, struct lu_copyright_options_t *);
+int get_current_year ();
+int parse_yearspec (char *yearspec, int *years);
+char * format_copyright_years (int *years, int abbreviate);
+//put the years in ADD into the copyright notices in TEXT, or use only those
+//years when REPLACE is set.  returns a new string if any notice changed.
+char * update_copyright_years (const char *text, int *add, int replace, int abbreviate);
 extern struct lu_command_t copyright;
 #endif
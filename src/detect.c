@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <argz.h>
 #include "licensing_priv.h"
 #include "detect.h"
@@ -32,6 +33,11 @@
 #include "copy-file.h"
 #include "fstrcmp.h"
 #include "findprog.h"
+#include "stats.h"
+#include "result-cache.h"
+#include "scan-cache.h"
+#include "styles.h"
+#include "util.h"
 
 enum detect_options_enum_t
 {
@@ -149,28 +155,29 @@ squeeze (char *s)
   return result;
 }
 
+//SS1 is a license notice and SS2 is the text being detected, both
+//already squeezed.
 static float
-sherlock (char *license_filename, char *filename)
-{
-  double results;
-  size_t s1_len, s2_len;
-  FILE *f1 = fopen (license_filename, "r");
-  FILE *f2 = fopen (filename, "r");
-  char *s1 = fread_file (f1, &s1_len);
-  char *s2 = fread_file (f2, &s2_len);
-  fclose (f1);
-  fclose (f2);
-  char *ss1 = squeeze (s1);
-  char *ss2 = squeeze (s2);
-  free (s1);
-  free (s2);
+sherlock (char *ss1, char *ss2)
+{
   if (strstr (ss2, ss1) == NULL)
-    results = fstrcmp (ss1, ss2);
-  else
-    results = 1;
-  free (ss1);
-  free (ss2);
-  return results;
+    return fstrcmp (ss1, ss2);
+  return 1;
+}
+
+static char *
+dump_text_to_file (char *text)
+{
+  char tmp[sizeof(PACKAGE) + 13];
+  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
+  int fd = mkstemp(tmp);
+  if (fd == -1)
+    return NULL;
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
+  FILE *fileptr = fdopen (fd, "w");
+  fprintf (fileptr, "%s", text);
+  fclose (fileptr);
+  return strdup (tmp);
 }
 
 static int 
@@ -191,54 +198,221 @@ visual_diff (char *diff_program, char *diff_options, char* license_filename, cha
     opts = diff_options;
   char *cmd = xasprintf ("%s %s %s %s", prog, opts, license_filename, filename);
   free ( (char *) prog);
+  lu_stats_add (LU_STATS_SPAWNS, 1);
+  gint64 start = lu_stats_start ();
   system (cmd);
+  lu_stats_stop (LU_STATS_SPAWN_TIME, start);
   free (cmd);
   return 0;
 }
 
-static int
-detect_licenses (struct lu_state_t *state, struct lu_detect_options_t *options, char *filename)
+struct lu_license_notice_t
+{
+  char *license;
+  char *cmd;
+  char *squeezed;
+};
+
+struct lu_license_notices_t
+{
+  struct lu_license_notice_t *notices;
+  int num_notices;
+};
+
+struct lu_license_notices_t *
+lu_license_notices_new (struct lu_state_t *state)
 {
   char *argz = NULL;
   size_t argz_len = 0;
   char *licenses = lu_list_of_license_keyword_commands ();
   argz_create_sep (licenses, '\n', &argz, &argz_len);
-  int n = argz_count (argz, argz_len);
-  struct license_result_t *m = malloc (n * sizeof (struct license_result_t));
-  memset (m, 0, n * sizeof (struct license_result_t));
-  int i = 0;
+  free (licenses);
+  struct lu_license_notices_t *n = malloc (sizeof (struct lu_license_notices_t));
+  n->notices = calloc (argz_count (argz, argz_len) + 1,
+                       sizeof (struct lu_license_notice_t));
+  n->num_notices = 0;
   char *license = NULL;
-  //collect results
   while ((license = argz_next (argz, argz_len, license)))
     {
       char *cmd = strchr (license, ' ');
-      cmd++;
+      if (!cmd)
+        continue;
+      *cmd++ = '\0';
       char *license_filename = lu_dump_command_to_file (state, cmd);
-      float results = sherlock (license_filename, filename) * 100;
+      size_t len = 0;
+      char *text = NULL;
+      FILE *fp = fopen (license_filename, "r");
+      if (fp)
+        {
+          text = fread_file (fp, &len);
+          fclose (fp);
+        }
       remove (license_filename);
       free (license_filename);
-      cmd = strchr (license, ' ');
-      *cmd = '\0';
-      m[i].license = strdup (license);
-      m[i].cmd = strdup (++cmd);
-      --cmd;
-      m[i].result = results;
-      *cmd = ' ';
+      struct lu_license_notice_t *notice = &n->notices[n->num_notices++];
+      notice->license = strdup (license);
+      notice->cmd = strdup (cmd);
+      notice->squeezed = squeeze (text ? text : "");
+      free (text);
+    }
+  free (argz);
+  return n;
+}
+
+void
+lu_license_notices_free (struct lu_license_notices_t *n)
+{
+  for (int i = 0; i < n->num_notices; i++)
+    {
+      free (n->notices[i].license);
+      free (n->notices[i].cmd);
+      free (n->notices[i].squeezed);
+    }
+  free (n->notices);
+  free (n);
+}
+
+static struct license_result_t *
+compare_notices (struct lu_license_notices_t *n, char *text, int *num_results)
+{
+  char *squeezed = squeeze (text);
+  struct license_result_t *m =
+    calloc (n->num_notices + 1, sizeof (struct license_result_t));
+  for (int i = 0; i < n->num_notices; i++)
+    {
+      m[i].license = strdup (n->notices[i].license);
+      m[i].cmd = strdup (n->notices[i].cmd);
+      m[i].result = sherlock (n->notices[i].squeezed, squeezed) * 100;
+    }
+  free (squeezed);
+  if (n->num_notices)
+    qsort (m, n->num_notices, sizeof (struct license_result_t),
+           compare_license_results);
+  *num_results = n->num_notices;
+  return m;
+}
+
+static struct license_result_t *
+compare_licenses (struct lu_state_t *state, char *text, int *num_results)
+{
+  struct lu_license_notices_t *notices = lu_license_notices_new (state);
+  struct license_result_t *m = compare_notices (notices, text, num_results);
+  lu_license_notices_free (notices);
+  return m;
+}
+
+//the results go in the result cache as lines of license, command and
+//percentage, separated by tabs.
+static char *
+save_license_results (struct license_result_t *m, int n)
+{
+  char *argz = NULL;
+  size_t len = 0;
+  for (int i = 0; i < n; i++)
+    {
+      char *line = xasprintf ("%s\t%s\t%.9g", m[i].license, m[i].cmd,
+                              m[i].result);
+      argz_add (&argz, &len, line);
+      free (line);
+    }
+  argz_stringify (argz, len, '\n');
+  return argz ? argz : strdup ("");
+}
+
+static struct license_result_t *
+load_license_results (char *saved, int *num_results)
+{
+  char *argz = NULL;
+  size_t len = 0;
+  argz_create_sep (saved, '\n', &argz, &len);
+  int n = argz_count (argz, len);
+  struct license_result_t *m = malloc (n * sizeof (struct license_result_t));
+  memset (m, 0, n * sizeof (struct license_result_t));
+  int i = 0;
+  char *line = NULL;
+  while ((line = argz_next (argz, len, line)))
+    {
+      char *cmd = strchr (line, '\t');
+      char *result = cmd ? strchr (cmd + 1, '\t') : NULL;
+      if (!result)
+        continue;
+      m[i].license = strndup (line, cmd - line);
+      m[i].cmd = strndup (cmd + 1, result - cmd - 1);
+      m[i].result = strtod (result + 1, NULL);
       i++;
     }
   free (argz);
-  free (licenses);
-  //sort and display results
+  *num_results = i;
+  return m;
+}
+
+//how similar TEXT is to every license, the most similar first.  the
+//same boilerplate is in many files, so the results are kept.  the
+//results are also put in SAVED when it isn't NULL.
+static struct license_result_t *
+get_license_results (struct lu_state_t *state, char *text, int *num_results, char **saved)
+{
+  char *results = NULL;
+  size_t results_len = 0;
+  struct license_result_t *m;
+  if (lu_result_cache_lookup ("detect", text, strlen (text), &results,
+                              &results_len) && results)
+    m = load_license_results (results, num_results);
+  else
+    {
+      m = compare_licenses (state, text, num_results);
+      results = save_license_results (m, *num_results);
+      lu_result_cache_store ("detect", text, strlen (text), results,
+                             strlen (results));
+    }
+  if (saved)
+    *saved = results;
+  else
+    free (results);
+  return m;
+}
+
+static void
+free_license_results (struct license_result_t *m, int n)
+{
+  for (int i = 0; i < n; i++)
+    {
+      free (m[i].license);
+      free (m[i].cmd);
+    }
+  free (m);
+}
+
+//TEXT came from FILENAME, or from the standard input when FILENAME is NULL.
+//TEXT and FILENAME are only needed to show the differences.
+static void
+show_license_results (struct lu_state_t *state, struct lu_detect_options_t *options, struct license_result_t *m, int n, char *text, char *filename)
+{
+  int i = 0;
+  //display results
   if (n)
     {
-      qsort (m, n, sizeof (struct license_result_t), compare_license_results);
       if (options->show)
         {
           char *license_filename = lu_dump_command_to_file (state, m[0].cmd);
+          //the diff program needs the standard input in a file.
+          char *tmp = NULL;
+          if (!filename)
+            {
+              tmp = dump_text_to_file (text);
+              filename = tmp;
+            }
 
-          visual_diff (options->diff_program, getenv ("LU_DIFF_OPTS"),
-                       license_filename, filename);
+          if (filename)
+            visual_diff (options->diff_program, getenv ("LU_DIFF_OPTS"),
+                         license_filename, filename);
           remove (license_filename);
+          free (license_filename);
+          if (tmp)
+            {
+              remove (tmp);
+              free (tmp);
+            }
         }
       else
         {
@@ -251,49 +425,65 @@ detect_licenses (struct lu_state_t *state, struct lu_detect_options_t *options,
             }
         }
     }
+}
 
-  for (i = 0; i < n; i++)
-    {
-      free (m[i].license);
-      free (m[i].cmd);
-    }
-  free (m);
+static int
+detect_licenses (struct lu_state_t *state, struct lu_detect_options_t *options, char *text, char *filename, char **saved)
+{
+  int n = 0;
+  struct license_result_t *m = get_license_results (state, text, &n, saved);
+  show_license_results (state, options, m, n, text, filename);
+  free_license_results (m, n);
   return 0;
 }
 
 static int
 detect_stdin (struct lu_state_t *state, struct lu_detect_options_t *options)
 {
-  int err = 0;
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fileptr = fopen (tmp, "w");
-  if (fileptr)
+  size_t len = 0;
+  int more = 0;
+  char *data = lu_read_head (stdin, &len, &more);
+  if (!data)
+    return -1;
+  if (more)
     {
-      char *line = NULL;
-      size_t len = 0;
-      ssize_t read;
-
-      while ((read = getline(&line, &len, stdin)) != -1)
-        fprintf (fileptr, "%s", line);
-
-      free (line);
-      fflush (fileptr);
-      fsync (fileno (fileptr));
-      fclose (fileptr);
-      detect_licenses (state, options, tmp);
-      remove (tmp);
+      error (0, 0, N_("the standard input is bigger than the memory budget"));
+      free (data);
+      return -1;
     }
-  else
-    err = -1;
-  return err;
+  detect_licenses (state, options, data, NULL, NULL);
+  free (data);
+  return 0;
+}
+
+//the licenses found in a file that hasn't changed since the last run
+//come from the scan cache.
+static int
+detect_scanned_file (struct lu_state_t *state, struct lu_detect_options_t *options, struct stat *st)
+{
+  char *saved = NULL;
+  size_t saved_len = 0;
+  if (options->show ||
+      !lu_scan_cache_lookup ("detect", options->input_file, st, &saved,
+                             &saved_len))
+    return 0;
+  int n = 0;
+  struct license_result_t *m = load_license_results (saved, &n);
+  show_license_results (state, options, m, n, NULL, NULL);
+  free_license_results (m, n);
+  free (saved);
+  return 1;
 }
 
 static int
 detect_uncommented_boilerplate (struct lu_state_t *state, struct lu_detect_options_t *options)
 {
+  struct stat st;
+  memset (&st, 0, sizeof (st));
+  stat (options->input_file, &st);
+  if (detect_scanned_file (state, options, &st))
+    return 0;
+
   struct lu_boilerplate_options_t boilerplate_options;
   memset (&boilerplate_options, 0, sizeof (boilerplate_options));
   argz_add (&boilerplate_options.input_files, &boilerplate_options.input_files_len, options->input_file);
@@ -302,6 +492,7 @@ detect_uncommented_boilerplate (struct lu_state_t *state, struct lu_detect_optio
   snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
   int fd = mkstemp(tmp);
   close (fd);
+  lu_stats_add (LU_STATS_TEMP_FILES, 2);
   char *tmpext = xasprintf ("%s.%s", tmp, basename (options->input_file));
   rename (tmp, tmpext);
   FILE *fileptr = fopen (tmpext, "w");
@@ -325,13 +516,137 @@ detect_uncommented_boilerplate (struct lu_state_t *state, struct lu_detect_optio
   state->out = oldout;
   fclose (fileptr);
 
-  detect_licenses (state, options, tmp2);
+  fileptr = fopen (tmp2, "r");
+  if (fileptr)
+    {
+      size_t len = 0;
+      char *data = lu_read_head (fileptr, &len, NULL);
+      fclose (fileptr);
+      if (data)
+        {
+          char *saved = NULL;
+          detect_licenses (state, options, data, tmp2, &saved);
+          lu_scan_cache_store ("detect", options->input_file, &st, saved,
+                               strlen (saved));
+          free (saved);
+          free (data);
+        }
+    }
   remove (tmpext);
   free (tmpext);
   remove (tmp2);
   return err;
 }
 
+char *
+lu_license_notices_match (void *notices, char *text)
+{
+  int n = 0;
+  struct license_result_t *m = compare_notices (notices, text, &n);
+  char *license = NULL;
+  if (n && m[0].result >= LU_DETECT_MIN_SIMILARITY)
+    license = strdup (m[0].license);
+  free_license_results (m, n);
+  return license;
+}
+
+char *
+lu_detect_license (struct lu_state_t *state, char *text)
+{
+  int n = 0;
+  struct license_result_t *m = get_license_results (state, text, &n, NULL);
+  char *license = NULL;
+  if (n && m[0].license && m[0].result >= LU_DETECT_MIN_SIMILARITY)
+    license = strdup (m[0].license);
+  free_license_results (m, n);
+  return license;
+}
+
+//the comments are uncommented and put one after the other, the way that
+//the uncomment command shows them.
+static char *
+get_uncommented_text (struct lu_comment_style_t *style, char *argz, size_t len)
+{
+  lu_uncomment_in_style (style, &argz, &len, 0);
+  if (!argz)
+    return strdup ("");
+  argz_stringify (argz, len, '\n');
+  char *text = xasprintf ("%s\n", argz);
+  free (argz);
+  return text;
+}
+
+//the scan cache keeps the name of the style, a nul and the license, or
+//nothing when the file has no comments at the top.
+int
+lu_detect_license_of_stream (struct lu_state_t *state, char *file, FILE *fp, struct lu_comment_style_t *style, lu_license_matcher_t match, void *match_data, struct lu_comment_style_t **found, char **license)
+{
+  *found = NULL;
+  *license = NULL;
+  struct stat st;
+  memset (&st, 0, sizeof (st));
+  fstat (fileno (fp), &st);
+  char *kind = xasprintf ("license-%s", style ? style->name : "auto");
+  char *saved = NULL;
+  size_t saved_len = 0;
+  int has_comments = 0;
+  if (lu_scan_cache_lookup (kind, file, &st, &saved, &saved_len))
+    {
+      if (saved)
+        {
+          has_comments = 1;
+          *found = lu_lookup_comment_style (saved);
+          size_t name_len = strlen (saved) + 1;
+          if (saved_len > name_len)
+            *license = strdup (&saved[name_len]);
+        }
+    }
+  else
+    {
+      char *argz = NULL;
+      size_t len = 0;
+      *found = lu_get_comment_blocks_of_file (style, file, fp, &argz, &len);
+      if (argz && *found)
+        {
+          has_comments = 1;
+          char *text = get_uncommented_text (*found, argz, len);
+          if (match)
+            *license = match (match_data, text);
+          else
+            *license = lu_detect_license (state, text);
+          free (text);
+          size_t name_len = strlen ((*found)->name) + 1;
+          size_t license_len = *license ? strlen (*license) : 0;
+          saved_len = name_len + license_len;
+          saved = malloc (saved_len);
+          memcpy (saved, (*found)->name, name_len);
+          if (*license)
+            memcpy (&saved[name_len], *license, license_len);
+        }
+      else
+        free (argz);
+      lu_scan_cache_store (kind, file, &st, saved, saved_len);
+    }
+  free (saved);
+  free (kind);
+  return has_comments;
+}
+
+int
+lu_detect_license_of_file (struct lu_state_t *state, char *file, struct lu_comment_style_t *style, lu_license_matcher_t match, void *match_data, struct lu_comment_style_t **found, char **license)
+{
+  *found = NULL;
+  *license = NULL;
+  FILE *fp = fopen (file, "r");
+  if (!fp)
+    return 0;
+  int has_comments = lu_detect_license_of_stream (state, file, fp, style,
+                                                  match, match_data, found,
+                                                  license);
+  fclose (fp);
+  return has_comments;
+}
+
 int 
 lu_detect (struct lu_state_t *state, struct lu_detect_options_t *options)
 {
@@ -21,6 +21,7 @@
 #include <config.h>
 #include <argp.h>
 #include "licensing.h"
+#include "comment-style.h"
 
 struct lu_detect_options_t
 {
@@ -30,7 +31,38 @@ struct lu_detect_options_t
   char *diff_program;
 };
 
+//how like a license notice some text has to be, in percent, before it is
+//taken to be that license.
+#define LU_DETECT_MIN_SIMILARITY 50.0
+
 int lu_detect_parse_argp (struct lu_state_t *, int argc, char **argv);
 int lu_detect (struct lu_state_t *, struct lu_detect_options_t *);
+
+//the keyword of the license that TEXT is most like, or NULL when it
+//isn't much like any of them.
+char * lu_detect_license (struct lu_state_t *state, char *text);
+
+//the license notices, squeezed and ready to be compared with.  once
+//they're made, many threads can use them at the same time.
+struct lu_license_notices_t;
+struct lu_license_notices_t * lu_license_notices_new (struct lu_state_t *state);
+void lu_license_notices_free (struct lu_license_notices_t *notices);
+
+//like lu_detect_license, but with NOTICES instead of the result cache.
+char * lu_license_notices_match (void *notices, char *text);
+
+//gives the keyword of the license that TEXT is most like, or NULL.
+typedef char * (*lu_license_matcher_t) (void *data, char *text);
+
+//look at the comments at the top of FILE in STYLE, or in the
+//auto-detected style when STYLE is NULL.  returns 0 when there aren't
+//any, otherwise 1 with the style they're in in FOUND and the keyword of
+//the license they're most like, or NULL, in LICENSE.  MATCH is given
+//MATCH_DATA and the uncommented text, or lu_detect_license is used when
+//MATCH is NULL.
+int lu_detect_license_of_file (struct lu_state_t *state, char *file, struct lu_comment_style_t *style, lu_license_matcher_t match, void *match_data, struct lu_comment_style_t **found, char **license);
+
+//like lu_detect_license_of_file, but FILE has already been opened as FP.
+int lu_detect_license_of_stream (struct lu_state_t *state, char *file, FILE *fp, struct lu_comment_style_t *style, lu_license_matcher_t match, void *match_data, struct lu_comment_style_t **found, char **license);
 extern struct lu_command_t detect;
 #endif
@@ -22,10 +22,13 @@
 #include "forget.h"
 #include "help.h"
 #include "url-downloader.h"
+#include "preview.h"
+#include "result-cache.h"
+#include "scan-cache.h"
 #include "gettext-more.h"
 
 #undef FORGET_DOC
-#define FORGET_DOC N_("Clear the downloaded files cache.")
+#define FORGET_DOC N_("Clear the downloaded files cache, the rendered boilerplate cache, the result cache and the scan cache.")
 static struct argp argp = { NULL, NULL, "", FORGET_DOC};
 
 int 
@@ -46,6 +49,9 @@ int
 lu_forget (struct lu_state_t *state, struct lu_forget_options_t *options)
 {
   clear_download_cache ();
+  clear_boilerplate_cache ();
+  clear_result_cache ();
+  clear_scan_cache ();
   return 0;
 }
 
@@ -0,0 +1,336 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "c-ctype.h"
+#include "formatter.h"
+
+/* this is the optimal-fit algorithm from GNU fmt, cut down to the
+   default behaviour: no prefixes, no crown or tagged paragraphs,
+   and no uniform spacing.  we only use it for the top line and the
+   project line, but the output has to match what `fmt' used to give us
+   or everybody's boilerplate would change underneath them. */
+
+typedef long long cost_t;
+
+#define MAXCOST LLONG_MAX
+#define LEEWAY 7
+#define EQUIV(n) ((cost_t) (n) * (n))
+#define SHORT_COST(n) EQUIV ((n) * 10)
+#define RAGGED_COST(n) (SHORT_COST (n) / 2)
+#define LINE_COST EQUIV (70)
+#define WIDOW_COST(n) (EQUIV (200) / ((n) + 2))
+#define ORPHAN_COST(n) (EQUIV (150) / ((n) + 2))
+#define SENTENCE_BONUS EQUIV (50)
+#define NOBREAK_COST EQUIV (600)
+#define PAREN_BONUS EQUIV (40)
+#define PUNCT_BONUS EQUIV (40)
+
+#define isopen(c) ((c) != '\0' && strchr ("(['`\"", (c)) != NULL)
+#define isclose(c) ((c) != '\0' && strchr (")]'\"", (c)) != NULL)
+#define isperiod(c) ((c) != '\0' && strchr (".?!", (c)) != NULL)
+
+struct word_t
+{
+  const char *text;
+  int length;
+  int space; //how many spaces follow this word
+  int paren;
+  int period;
+  int punct;
+  int final;
+  int line_length;
+  cost_t best_cost;
+  struct word_t *next_break;
+};
+
+struct paragraph_t
+{
+  struct word_t *words;
+  size_t num_words;
+  size_t max_words;
+  int indent;
+  int max_width;
+  int goal_width;
+  int last_line_length;
+  int tabs; //did we see any tabs?  then we write them too.
+};
+
+static void
+check_punctuation (struct word_t *w)
+{
+  const char *start = w->text;
+  const char *finish = start + (w->length - 1);
+  w->paren = isopen (*start);
+  w->punct = c_ispunct ((unsigned char) *finish);
+  while (start < finish && isclose (*finish))
+    finish--;
+  w->period = isperiod (*finish);
+}
+
+static struct word_t *
+add_word (struct paragraph_t *p, const char *text, int length)
+{
+  //keep one spare slot for the sentinel word.
+  if (p->num_words + 1 >= p->max_words)
+    {
+      p->max_words = p->max_words ? p->max_words * 2 : 64;
+      p->words = realloc (p->words, p->max_words * sizeof (struct word_t));
+    }
+  struct word_t *w = &p->words[p->num_words++];
+  memset (w, 0, sizeof (struct word_t));
+  w->text = text;
+  w->length = length;
+  check_punctuation (w);
+  return w;
+}
+
+static cost_t
+line_cost (struct paragraph_t *p, struct word_t *next, int len)
+{
+  struct word_t *limit = &p->words[p->num_words];
+  if (next == limit)
+    return 0;
+  int n = p->goal_width - len;
+  cost_t cost = SHORT_COST (n);
+  if (next->next_break != limit)
+    {
+      n = len - next->line_length;
+      cost += RAGGED_COST (n);
+    }
+  return cost;
+}
+
+static cost_t
+base_cost (struct paragraph_t *p, struct word_t *this)
+{
+  struct word_t *word = p->words;
+  cost_t cost = LINE_COST;
+  if (this > word)
+    {
+      if ((this - 1)->period)
+        {
+          if ((this - 1)->final)
+            cost -= SENTENCE_BONUS;
+          else
+            cost += NOBREAK_COST;
+        }
+      else if ((this - 1)->punct)
+        cost -= PUNCT_BONUS;
+      else if (this > word + 1 && (this - 2)->final)
+        cost += WIDOW_COST ((this - 1)->length);
+    }
+  if (this->paren)
+    cost -= PAREN_BONUS;
+  else if (this->final)
+    cost += ORPHAN_COST (this->length);
+  return cost;
+}
+
+//work backwards from the end, finding the cheapest place to break each line.
+static void
+fill_paragraph (struct paragraph_t *p)
+{
+  struct word_t *word = p->words;
+  struct word_t *limit = &p->words[p->num_words];
+  memset (limit, 0, sizeof (struct word_t));
+  limit->length = p->max_width;
+  limit->best_cost = 0;
+
+  for (struct word_t *start = limit - 1; start >= word; start--)
+    {
+      cost_t best = MAXCOST;
+      int len = p->indent + start->length;
+      struct word_t *w = start;
+      do
+        {
+          w++;
+          cost_t wcost = line_cost (p, w, len) + w->best_cost;
+          if (start == word && p->last_line_length > 0)
+            wcost += RAGGED_COST (len - p->last_line_length);
+          if (wcost < best)
+            {
+              best = wcost;
+              start->next_break = w;
+              start->line_length = len;
+            }
+          if (w == limit)
+            break;
+          len += (w - 1)->space + w->length;
+        }
+      while (len < p->max_width);
+      start->best_cost = best + base_cost (p, start);
+    }
+}
+
+static int
+put_space (struct paragraph_t *p, int column, int space, FILE *out)
+{
+  int target = column + space;
+  if (p->tabs)
+    {
+      int nexttab = target / 8 * 8;
+      if (column + 1 < nexttab)
+        while (column < nexttab)
+          {
+            fputc ('\t', out);
+            column = (column / 8 + 1) * 8;
+          }
+    }
+  for (; column < target; column++)
+    fputc (' ', out);
+  return column;
+}
+
+static void
+put_paragraph (struct paragraph_t *p, FILE *out)
+{
+  struct word_t *limit = &p->words[p->num_words];
+  struct word_t *w = p->words;
+  while (w != limit)
+    {
+      struct word_t *end = w->next_break - 1;
+      int column = put_space (p, 0, p->indent, out);
+      for (; w != end; w++)
+        {
+          column += fprintf (out, "%.*s", w->length, w->text);
+          column = put_space (p, column, w->space, out);
+        }
+      column += fprintf (out, "%.*s", w->length, w->text);
+      fprintf (out, "\n");
+      p->last_line_length = column;
+      w = end + 1;
+    }
+}
+
+//how far in is the first non-blank character of LINE?
+static int
+get_indent (struct paragraph_t *p, const char *line, const char **text)
+{
+  int column = 0;
+  while (*line == ' ' || *line == '\t')
+    {
+      if (*line == '\t')
+        {
+          p->tabs = 1;
+          column = (column / 8 + 1) * 8;
+        }
+      else
+        column++;
+      line++;
+    }
+  *text = line;
+  return column;
+}
+
+//split the line into words and tack them onto the paragraph.
+static void
+get_words (struct paragraph_t *p, const char *line, const char *eol, int column)
+{
+  const char *ptr = line;
+  while (ptr < eol)
+    {
+      const char *start = ptr;
+      while (ptr < eol && *ptr != ' ' && *ptr != '\t')
+        ptr++;
+      struct word_t *w = add_word (p, start, ptr - start);
+      column += w->length;
+      int word_end = column;
+      while (ptr < eol && (*ptr == ' ' || *ptr == '\t'))
+        {
+          if (*ptr == '\t')
+            {
+              p->tabs = 1;
+              column = (column / 8 + 1) * 8;
+            }
+          else
+            column++;
+          ptr++;
+        }
+      w->space = column - word_end;
+      if (ptr == eol)
+        {
+          w->final = w->period;
+          w->space = w->final ? 2 : 1;
+        }
+      else
+        w->final = (w->period && w->space > 1);
+    }
+}
+
+char *
+format_paragraphs (const char *text, int max_width)
+{
+  char *result = NULL;
+  size_t result_len = 0;
+  FILE *out = open_memstream (&result, &result_len);
+  if (!out)
+    return NULL;
+
+  struct paragraph_t p;
+  memset (&p, 0, sizeof (p));
+  p.max_width = max_width;
+  p.goal_width = max_width * (2 * (100 - LEEWAY) + 1) / 200;
+
+  const char *line = text;
+  while (line && *line)
+    {
+      const char *words;
+      int indent = get_indent (&p, line, &words);
+      const char *eol = strchr (words, '\n');
+      if (!eol)
+        eol = words + strlen (words);
+      if (eol == words)
+        {
+          //blank lines go straight through.
+          fprintf (out, "\n");
+          line = *eol ? eol + 1 : NULL;
+          continue;
+        }
+
+      //a paragraph is a run of non-blank lines with the same indentation.
+      p.num_words = 0;
+      p.indent = indent;
+      p.last_line_length = 0;
+      while (1)
+        {
+          get_words (&p, words, eol, indent);
+          line = *eol ? eol + 1 : NULL;
+          if (!line || *line == '\0')
+            break;
+          const char *next_words;
+          if (get_indent (&p, line, &next_words) != indent
+              || *next_words == '\n' || *next_words == '\0')
+            break;
+          words = next_words;
+          eol = strchr (words, '\n');
+          if (!eol)
+            eol = words + strlen (words);
+        }
+      //the last word of a paragraph always ends a sentence.
+      p.words[p.num_words - 1].final = 1;
+      fill_paragraph (&p);
+      put_paragraph (&p, out);
+    }
+  free (p.words);
+  fclose (out);
+  return result;
+}
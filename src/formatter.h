@@ -15,9 +15,11 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
   02110-1301, USA.
 */
-#ifndef LU_JAVASCRIPT_STYLE_H
-#define LU_JAVASCRIPT_STYLE_H 1
-#include "comment-style.h"
-extern struct lu_comment_style_t javascript_style;
-extern struct argp javascript_style_argp;
+#ifndef LU_FORMATTER_H
+#define LU_FORMATTER_H 1
+
+#define FORMATTER_DEFAULT_WIDTH 75
+
+//fill the paragraphs in TEXT the way fmt(1) does, and return a new string.
+char * format_paragraphs (const char *text, int max_width);
 #endif
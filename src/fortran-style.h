@@ -1,23 +0,0 @@
-/*  Copyright (C) 2013 Ben Asselstine
-
-  This program is free software; you can redistribute it and/or modify
-  it under the terms of the GNU General Public License as published by
-  the Free Software Foundation; either version 3 of the License, or
-  (at your option) any later version.
-
-  This program is distributed in the hope that it will be useful,
-  but WITHOUT ANY WARRANTY; without even the implied warranty of
-  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-  GNU General Public License for more details.
-
-  You should have received a copy of the GNU General Public License
-  along with this program; if not, write to the Free Software
-  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
-  02110-1301, USA.
-*/
-#ifndef LU_FORTRAN_STYLE_H
-#define LU_FORTRAN_STYLE_H 1
-#include "comment-style.h"
-extern struct lu_comment_style_t fortran_style;
-extern struct argp fortran_style_argp;
-#endif
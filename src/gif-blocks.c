@@ -0,0 +1,265 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gif-blocks.h"
+#include "image-formats.h"
+#include "util.h"
+
+/* gif files are a header, a screen descriptor and maybe a colour table,
+   and then a list of blocks until the trailer.  the image data and the
+   extensions are split into sub-blocks that start with a length byte, and
+   a zero length ends them.  the sub-blocks have to be walked to find the
+   end of a block, but what's in them is never looked at. */
+
+#define EXTENSION 0x21
+#define IMAGE 0x2c
+#define TRAILER 0x3b
+#define COMMENT_LABEL 0xfe
+#define APPLICATION_LABEL 0xff
+
+int
+lu_gif_detect (const unsigned char *buf, size_t len)
+{
+  return len >= 6 && (memcmp (buf, "GIF87a", 6) == 0 ||
+                      memcmp (buf, "GIF89a", 6) == 0);
+}
+
+static int
+read_bytes (FILE *fp, unsigned char *buf, size_t len)
+{
+  if (fread (buf, 1, len, fp) != len)
+    return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+  return 0;
+}
+
+static size_t
+colour_table_size (unsigned char flags)
+{
+  if (!(flags & 0x80))
+    return 0;
+  return 3 * (1 << ((flags & 0x07) + 1));
+}
+
+//go through sub-blocks until the empty one, copying them to OUT if it
+//isn't NULL, and adding what's in them to *TEXT if it isn't NULL.
+static int
+walk_sub_blocks (FILE *fp, FILE *out, char **text, size_t *text_len)
+{
+  unsigned char buf[255];
+  while (1)
+    {
+      int n = getc (fp);
+      if (n == EOF)
+        return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+      if (out)
+        putc (n, out);
+      if (n == 0)
+        break;
+      if (!out && !text)
+        {
+          if (fseeko (fp, n, SEEK_CUR) != 0)
+            return -1;
+          continue;
+        }
+      int err = read_bytes (fp, buf, n);
+      if (err)
+        return err;
+      if (out && fwrite (buf, 1, n, out) != n)
+        return -1;
+      if (text)
+        {
+          char *bigger = realloc (*text, *text_len + n + 1);
+          if (!bigger)
+            return -1;
+          *text = bigger;
+          memcpy (&(*text)[*text_len], buf, n);
+          *text_len += n;
+          (*text)[*text_len] = '\0';
+        }
+    }
+  return out && ferror (out) ? -1 : 0;
+}
+
+//the header, screen descriptor and global colour table.
+static int
+read_header (FILE *fp, unsigned char *header, size_t *colour_table_len)
+{
+  int err = read_bytes (fp, header, 13);
+  if (err)
+    return err;
+  if (!lu_gif_detect (header, 13))
+    return LU_IMAGE_MALFORMED;
+  *colour_table_len = colour_table_size (header[10]);
+  return 0;
+}
+
+//the image descriptor and local colour table, after the separator.
+static int
+copy_image_descriptor (FILE *fp, FILE *out)
+{
+  unsigned char buf[10 + 256 * 3];
+  int err = read_bytes (fp, buf, 9);
+  if (err)
+    return err;
+  size_t len = 9 + colour_table_size (buf[8]);
+  //and the lzw code size.
+  len++;
+  err = read_bytes (fp, &buf[9], len - 9);
+  if (err)
+    return err;
+  if (out && fwrite (buf, 1, len, out) != len)
+    return -1;
+  return 0;
+}
+
+static int
+write_comment (FILE *out, const char *text, size_t len)
+{
+  putc (EXTENSION, out);
+  putc (COMMENT_LABEL, out);
+  while (len > 0)
+    {
+      size_t n = len < 255 ? len : 255;
+      putc (n, out);
+      if (fwrite (text, 1, n, out) != n)
+        return -1;
+      text += n;
+      len -= n;
+    }
+  putc (0, out);
+  return ferror (out) ? -1 : 0;
+}
+
+int
+lu_gif_get_comment (FILE *fp, char **text)
+{
+  *text = NULL;
+  unsigned char header[13];
+  size_t colour_table_len = 0;
+  int err = read_header (fp, header, &colour_table_len);
+  if (err)
+    return err;
+  if (fseeko (fp, colour_table_len, SEEK_CUR) != 0)
+    return -1;
+  while (1)
+    {
+      int c = getc (fp);
+      if (c == TRAILER)
+        return 0;
+      else if (c == IMAGE)
+        {
+          err = copy_image_descriptor (fp, NULL);
+          if (!err)
+            err = walk_sub_blocks (fp, NULL, NULL, NULL);
+        }
+      else if (c == EXTENSION)
+        {
+          int label = getc (fp);
+          if (label == COMMENT_LABEL)
+            {
+              size_t len = 0;
+              err = walk_sub_blocks (fp, NULL, text, &len);
+              if (err)
+                {
+                  free (*text);
+                  *text = NULL;
+                }
+              else if (!*text)
+                *text = strdup ("");
+              return err;
+            }
+          err = label == EOF ? LU_IMAGE_MALFORMED
+            : walk_sub_blocks (fp, NULL, NULL, NULL);
+        }
+      else
+        err = ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+      if (err)
+        return err;
+    }
+}
+
+int
+lu_gif_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags)
+{
+  unsigned char header[13];
+  size_t colour_table_len = 0;
+  int err = read_header (fp, header, &colour_table_len);
+  if (err)
+    return err;
+  //comments came along in 89a.
+  if (text)
+    memcpy (header, "GIF89a", 6);
+  if (fwrite (header, 1, sizeof (header), out) != sizeof (header))
+    return -1;
+  unsigned char colour_table[256 * 3];
+  err = read_bytes (fp, colour_table, colour_table_len);
+  if (err)
+    return err;
+  if (fwrite (colour_table, 1, colour_table_len, out) != colour_table_len)
+    return -1;
+
+  int written = text == NULL;
+  while (1)
+    {
+      int c = getc (fp);
+      int label = -1;
+      if (c == EXTENSION)
+        {
+          label = getc (fp);
+          if (label == EOF)
+            return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+          if (label == COMMENT_LABEL)
+            {
+              err = walk_sub_blocks (fp, NULL, NULL, NULL);
+              if (err)
+                return err;
+              continue;
+            }
+        }
+      else if (c != IMAGE && c != TRAILER)
+        return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+
+      //the comment goes after the application extensions, so that the
+      //looping extension of an animation stays at the front.
+      if (!written && label != APPLICATION_LABEL)
+        {
+          if (write_comment (out, text, len) != 0)
+            return -1;
+          written = 1;
+        }
+      putc (c, out);
+      if (c == TRAILER)
+        break;
+      if (c == EXTENSION)
+        putc (label, out);
+      else
+        {
+          err = copy_image_descriptor (fp, out);
+          if (err)
+            return err;
+        }
+      err = walk_sub_blocks (fp, out, NULL, NULL);
+      if (err)
+        return err;
+    }
+
+  //keep anything that comes after the trailer.
+  return copy_rest_of_file (fp, out);
+}
@@ -0,0 +1,34 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_GIF_BLOCKS_H
+#define LU_GIF_BLOCKS_H 1
+
+#include <config.h>
+#include <stdio.h>
+
+int lu_gif_detect (const unsigned char *buf, size_t len);
+
+//put the first comment of the gif at FP into *TEXT, or NULL if there
+//isn't one.
+int lu_gif_get_comment (FILE *fp, char **text);
+
+//copy the gif at FP to OUT without decoding it, putting TEXT in a comment
+//extension in place of any that were there before.  when TEXT is NULL the
+//comments are just taken out.
+int lu_gif_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags);
+#endif
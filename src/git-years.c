@@ -0,0 +1,391 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <argz.h>
+#include <glib.h>
+#include "licensing_priv.h"
+#include "git-years.h"
+#include "copyright.h"
+#include "xvasprintf.h"
+#include "md2.h"
+#include "stats.h"
+
+/* the years are kept as one bit per year for every file in the repository,
+   which is made from one `git log --name-only' over the whole history.
+   the result goes into ~/.licenseutils/git-years/CHECKSUM, along with
+   the commit it was made from, so that next time we only have to look at
+   the commits that came after that one. */
+
+#define YEAR_BYTES ((COPYRIGHT_MAX_YEARS + 7) / 8)
+
+struct lu_git_repo_t
+{
+  char *toplevel;
+  char *head;
+  GHashTable *files; //path in the repository -> years
+};
+
+struct lu_git_years_t
+{
+  GHashTable *repos; //toplevel -> struct lu_git_repo_t
+  GHashTable *files; //file as given to us -> years
+};
+
+static void
+set_year (GHashTable *files, const char *path, int year)
+{
+  unsigned char *years = g_hash_table_lookup (files, path);
+  if (!years)
+    {
+      years = g_malloc0 (YEAR_BYTES);
+      g_hash_table_insert (files, strdup (path), years);
+    }
+  years[year / 8] |= 1 << (year % 8);
+}
+
+static char *
+get_head (char *toplevel)
+{
+  char *argv[] = {"git", "rev-parse", "--verify", "-q", "HEAD", NULL};
+  char *out = NULL;
+  int status = 0;
+  lu_stats_add (LU_STATS_SPAWNS, 1);
+  gint64 start = lu_stats_start ();
+  gboolean spawned = g_spawn_sync (toplevel, argv, NULL,
+                                   G_SPAWN_SEARCH_PATH |
+                                   G_SPAWN_STDERR_TO_DEV_NULL,
+                                   NULL, NULL, &out, NULL, &status, NULL);
+  lu_stats_stop (LU_STATS_SPAWN_TIME, start);
+  if (!spawned)
+    return NULL;
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0 || !out)
+    {
+      g_free (out);
+      return NULL;
+    }
+  char *head = strndup (out, strcspn (out, "\r\n"));
+  g_free (out);
+  return head;
+}
+
+//is COMMIT still in the history of HEAD?  it isn't after a rebase, a
+//reset or a switch to another branch.
+static int
+is_ancestor (struct lu_git_repo_t *repo, char *commit)
+{
+  char *argv[] = {"git", "merge-base", "--is-ancestor", commit, repo->head,
+    NULL};
+  int status = 0;
+  lu_stats_add (LU_STATS_SPAWNS, 1);
+  gint64 start = lu_stats_start ();
+  gboolean spawned = g_spawn_sync (repo->toplevel, argv, NULL,
+                                   G_SPAWN_SEARCH_PATH |
+                                   G_SPAWN_STDOUT_TO_DEV_NULL |
+                                   G_SPAWN_STDERR_TO_DEV_NULL,
+                                   NULL, NULL, NULL, NULL, &status, NULL);
+  lu_stats_stop (LU_STATS_SPAWN_TIME, start);
+  return spawned && WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+//go through the history from SINCE up to HEAD, or all of it.
+static int
+index_history (struct lu_git_repo_t *repo, char *since)
+{
+  char *range = since ? xasprintf ("%s..%s", since, repo->head)
+    : strdup (repo->head);
+  char *argv[] = {"git", "-c", "core.quotePath=false", "log", "--name-only",
+    "--date=short", "--format=%x01%ad", range, NULL};
+  GPid pid;
+  int fd = -1;
+  lu_stats_add (LU_STATS_SPAWNS, 1);
+  gint64 start = lu_stats_start ();
+  gboolean spawned =
+    g_spawn_async_with_pipes (repo->toplevel, argv, NULL,
+                              G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                              G_SPAWN_STDERR_TO_DEV_NULL,
+                              NULL, NULL, &pid, NULL, &fd, NULL, NULL);
+  free (range);
+  if (!spawned)
+    {
+      lu_stats_stop (LU_STATS_SPAWN_TIME, start);
+      return -1;
+    }
+
+  int max_year = get_current_year () - 1900;
+  int year = -1;
+  FILE *fp = fdopen (fd, "r");
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t read;
+  while ((read = getline (&line, &len, fp)) != -1)
+    {
+      if (read > 0 && line[read - 1] == '\n')
+        line[--read] = '\0';
+      if (line[0] == '\001')
+        {
+          year = atoi (&line[1]) - 1900;
+          if (year < 0 || year > max_year)
+            year = -1;
+        }
+      else if (line[0] != '\0' && line[0] != '"' && year != -1)
+        set_year (repo->files, line, year);
+    }
+  free (line);
+  fclose (fp);
+
+  int status = 0;
+  waitpid (pid, &status, 0);
+  g_spawn_close_pid (pid);
+  lu_stats_stop (LU_STATS_SPAWN_TIME, start);
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    return -1;
+  return 0;
+}
+
+static char *
+get_cache_file (char *toplevel)
+{
+  unsigned char buf[16];
+  md2_buffer (toplevel, strlen (toplevel), buf);
+  char cksum[sizeof (buf) * 2 + 1];
+  for (int i = 0; i < sizeof (buf); i++)
+    snprintf (&cksum[i * 2], 3, "%02x", buf[i]);
+  char *dir = get_config_file ("git-years");
+  mkdir (dir, 0775);
+  char *file = xasprintf ("%s/%s", dir, cksum);
+  free (dir);
+  return file;
+}
+
+//returns the commit that the cached years were made from.
+static char *
+load_cache (struct lu_git_repo_t *repo)
+{
+  char *file = get_cache_file (repo->toplevel);
+  FILE *fp = fopen (file, "r");
+  free (file);
+  if (!fp)
+    {
+      lu_stats_add (LU_STATS_CACHE_MISSES, 1);
+      return NULL;
+    }
+  lu_stats_add (LU_STATS_CACHE_HITS, 1);
+  char *commit = NULL;
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t read;
+  if ((read = getline (&line, &len, fp)) != -1 &&
+      strncmp (line, "commit ", 7) == 0)
+    {
+      commit = strndup (&line[7], strcspn (&line[7], "\r\n"));
+      int years[COPYRIGHT_MAX_YEARS];
+      while ((read = getline (&line, &len, fp)) != -1)
+        {
+          if (line[read - 1] == '\n')
+            line[--read] = '\0';
+          char *path = strchr (line, '\t');
+          if (!path)
+            continue;
+          *path++ = '\0';
+          memset (years, 0, sizeof (years));
+          if (parse_yearspec (line, years) != 0)
+            continue;
+          for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
+            if (years[i])
+              set_year (repo->files, path, i);
+        }
+    }
+  free (line);
+  fclose (fp);
+  return commit;
+}
+
+static void
+save_cache (struct lu_git_repo_t *repo)
+{
+  char *file = get_cache_file (repo->toplevel);
+  char *tmp = xasprintf ("%s.XXXXXX", file);
+  int fd = mkstemp (tmp);
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
+  FILE *fp = fd != -1 ? fdopen (fd, "w") : NULL;
+  if (fp)
+    {
+      fprintf (fp, "commit %s\n", repo->head);
+      GHashTableIter iter;
+      gpointer key, value;
+      int years[COPYRIGHT_MAX_YEARS];
+      g_hash_table_iter_init (&iter, repo->files);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          unsigned char *bits = value;
+          for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
+            years[i] = (bits[i / 8] >> (i % 8)) & 1;
+          char *spec = format_copyright_years (years, 1);
+          fprintf (fp, "%s\t%s\n", spec + 1, (char *) key);
+          free (spec);
+        }
+      if (fclose (fp) == 0)
+        rename (tmp, file);
+      else
+        remove (tmp);
+    }
+  free (tmp);
+  free (file);
+}
+
+static void
+free_repo (gpointer data)
+{
+  struct lu_git_repo_t *repo = data;
+  g_hash_table_destroy (repo->files);
+  free (repo->head);
+  free (repo->toplevel);
+  free (repo);
+}
+
+static struct lu_git_repo_t *
+get_repo (struct lu_git_years_t *index, char *toplevel)
+{
+  struct lu_git_repo_t *repo = g_hash_table_lookup (index->repos, toplevel);
+  if (repo)
+    return repo;
+  repo = calloc (1, sizeof (struct lu_git_repo_t));
+  repo->toplevel = strdup (toplevel);
+  repo->files = g_hash_table_new_full (g_str_hash, g_str_equal, free, g_free);
+  repo->head = get_head (toplevel);
+  if (repo->head)
+    {
+      char *commit = load_cache (repo);
+      if (!commit || strcmp (commit, repo->head) != 0)
+        {
+          //the years of commits that aren't in the history anymore are
+          //in the cache too, so it can't be built on.
+          if (commit && !is_ancestor (repo, commit))
+            {
+              g_hash_table_remove_all (repo->files);
+              free (commit);
+              commit = NULL;
+            }
+          int err = index_history (repo, commit);
+          if (err && commit)
+            {
+              //the old commit is gone, so start over.
+              g_hash_table_remove_all (repo->files);
+              err = index_history (repo, NULL);
+            }
+          if (!err)
+            save_cache (repo);
+        }
+      free (commit);
+    }
+  g_hash_table_insert (index->repos, repo->toplevel, repo);
+  return repo;
+}
+
+//which repository is DIR in?  the answers are remembered in DIRS.
+static char *
+find_toplevel (GHashTable *dirs, char *dir)
+{
+  char *toplevel = g_hash_table_lookup (dirs, dir);
+  if (toplevel)
+    return toplevel;
+  struct stat st;
+  char *git = xasprintf ("%s/.git", strcmp (dir, "/") == 0 ? "" : dir);
+  if (stat (git, &st) == 0)
+    toplevel = dir;
+  else if (strcmp (dir, "/") == 0)
+    toplevel = "";
+  else
+    {
+      char *parent = strdup (dir);
+      char *slash = strrchr (parent, '/');
+      if (slash == parent)
+        slash++;
+      *slash = '\0';
+      toplevel = find_toplevel (dirs, parent);
+      free (parent);
+    }
+  free (git);
+  toplevel = strdup (toplevel);
+  g_hash_table_insert (dirs, strdup (dir), toplevel);
+  return toplevel;
+}
+
+struct lu_git_years_t *
+lu_git_years_new (char *argz, size_t len)
+{
+  struct lu_git_years_t *index = calloc (1, sizeof (struct lu_git_years_t));
+  index->repos = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                        free_repo);
+  index->files = g_hash_table_new_full (g_str_hash, g_str_equal, free, NULL);
+  GHashTable *dirs = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+                                            free);
+  char *f = NULL;
+  while ((f = argz_next (argz, len, f)))
+    {
+      char *path = realpath (f, NULL);
+      if (!path)
+        continue;
+      char *dir = strdup (path);
+      char *slash = strrchr (dir, '/');
+      if (slash == dir)
+        slash++;
+      *slash = '\0';
+      char *toplevel = find_toplevel (dirs, dir);
+      if (*toplevel)
+        {
+          struct lu_git_repo_t *repo = get_repo (index, toplevel);
+          char *name = path + strlen (toplevel);
+          if (*name == '/')
+            name++;
+          unsigned char *years = g_hash_table_lookup (repo->files, name);
+          if (years)
+            g_hash_table_insert (index->files, strdup (f), years);
+        }
+      free (dir);
+      free (path);
+    }
+  g_hash_table_destroy (dirs);
+  return index;
+}
+
+int
+lu_git_years_lookup (struct lu_git_years_t *index, const char *file, int *years)
+{
+  unsigned char *bits = g_hash_table_lookup (index->files, file);
+  if (!bits)
+    return 0;
+  for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
+    if ((bits[i / 8] >> (i % 8)) & 1)
+      years[i] = 1;
+  return 1;
+}
+
+void
+lu_git_years_free (struct lu_git_years_t *index)
+{
+  g_hash_table_destroy (index->files);
+  g_hash_table_destroy (index->repos);
+  free (index);
+}
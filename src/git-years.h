@@ -1,4 +1,4 @@
-/*  Copyright (C) 2013 Ben Asselstine
+/*  Copyright (C) 2016 Ben Asselstine
 
   This program is free software; you can redistribute it and/or modify
   it under the terms of the GNU General Public License as published by
@@ -15,9 +15,19 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
   02110-1301, USA.
 */
-#ifndef LU_C_STYLE_H
-#define LU_C_STYLE_H 1
-#include "comment-style.h"
-extern struct lu_comment_style_t c_style;
-extern struct argp c_style_argp;
+#ifndef LU_GIT_YEARS_H
+#define LU_GIT_YEARS_H 1
+
+#include <config.h>
+#include <stddef.h>
+
+struct lu_git_years_t;
+
+//index the history of the git repositories that the files in ARGZ are in.
+struct lu_git_years_t * lu_git_years_new (char *argz, size_t len);
+
+//add the years that FILE was committed in to YEARS (from 1900.)
+int lu_git_years_lookup (struct lu_git_years_t *index, const char *file, int *years);
+
+void lu_git_years_free (struct lu_git_years_t *index);
 #endif
@@ -0,0 +1,242 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <argz.h>
+#include "licensing_priv.h"
+#include "image-apply.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "util.h"
+#include "preview.h"
+#include "image-formats.h"
+#include "batch.h"
+
+static struct argp_option argp_options[] = 
+{
+    {"no-backup", 'n', NULL, 0, 
+      N_("don't retain original image file in a .bak file")},
+    {"quiet", 'q', NULL, 0, N_("don't show diagnostic messages")},
+    {"recursive", 'R', NULL, 0,
+      N_("apply to the image files in directories too")},
+    {"jobs", 'j', "NUM", 0, N_("work on NUM files at a time")},
+    {"compress", 'z', NULL, 0,
+      N_("store the comment compressed in PNG files")},
+    {"utf8", 'u', NULL, 0,
+      N_("store the comment as UTF-8 in PNG files even if it is plain ASCII")},
+    {0}
+};
+
+static error_t 
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  struct lu_image_apply_options_t *opt = NULL;
+  if (state)
+    opt = (struct lu_image_apply_options_t*) state->input;
+  switch (key)
+    {
+    case 'q':
+      opt->quiet = 1;
+      break;
+    case 'n':
+      opt->backup = 0;
+      break;
+    case 'R':
+      opt->recursive = 1;
+      break;
+    case 'z':
+      opt->compress = 1;
+      break;
+    case 'u':
+      opt->utf8 = 1;
+      break;
+    case 'j':
+      opt->jobs = lu_batch_parse_jobs (arg);
+      if (opt->jobs == -1)
+        {
+          argp_failure (state, 0, 0,
+                        N_("`%s' is an invalid number of jobs"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    case ARGP_KEY_ARG:
+      argz_add (&opt->input_files, &opt->input_files_len, arg);
+      break;
+    case ARGP_KEY_INIT:
+      opt->input_files = NULL;
+      opt->input_files_len = 0;
+      opt->backup = 1;
+      opt->quiet = 0;
+      opt->recursive = 0;
+      opt->jobs = lu_batch_default_jobs ();
+      opt->compress = 0;
+      opt->utf8 = 0;
+      break;
+    case ARGP_KEY_FINI:
+      if (opt->input_files == NULL)
+        {
+          argp_failure (state, 0, 0, N_("no files specified"));
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
+
+#undef IMAGE_APPLY_DOC
+#define IMAGE_APPLY_DOC \
+  N_("Put the current working boilerplate into PNG, JPEG, GIF or SVG files.") "\v"\
+  N_("The kind of image is worked out from the start of each file.") "  "\
+  N_("With --recursive, the image files in directories are done too.")
+static struct argp argp = { argp_options, parse_opt, "FILE...", IMAGE_APPLY_DOC};
+
+int 
+lu_image_apply_parse_argp (struct lu_state_t *state, int argc, char **argv)
+{
+  int err = 0;
+  struct lu_image_apply_options_t opts;
+  opts.state = state;
+
+  err = argp_parse (&argp, argc, argv, state->argp_flags,  0, &opts);
+  if (!err)
+    return lu_image_apply (state, &opts);
+  else
+    return err;
+}
+
+static int
+save_comment (void *data, char *f, char **output, char **report)
+{
+  struct lu_image_apply_options_t *options = data;
+  if (access (f, W_OK) != 0)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), f,
+                                  errno);
+      return 1;
+    }
+  FILE *fp = fopen (f, "rb");
+  if (!fp)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for reading"), f,
+                                  errno);
+      return 1;
+    }
+  struct lu_image_format_t *format = lu_image_format_detect (fp);
+  if (!format)
+    {
+      *report = xasprintf (N_("`%s' is not a PNG, JPEG, GIF or SVG file"), f);
+      fclose (fp);
+      return 1;
+    }
+  char *tmp = NULL;
+  FILE *out = open_replacement_file (f, &tmp);
+  if (!out)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), tmp,
+                                  errno);
+      free (tmp);
+      fclose (fp);
+      return 1;
+    }
+  int flags = 0;
+  if (options->compress)
+    flags |= LU_IMAGE_COMPRESS;
+  if (options->utf8)
+    flags |= LU_IMAGE_UTF8;
+  int err = format->splice_comment (fp, out, options->data, options->data_len,
+                                    flags);
+  fclose (fp);
+  if (fclose (out) != 0 && !err)
+    err = -1;
+  if (err == LU_IMAGE_MALFORMED)
+    *report = xasprintf (N_("`%s' is not a %s file"), f, format->name);
+  else if (err)
+    *report = lu_batch_failure (N_("could not write `%s'"), tmp, errno);
+  else if (commit_replacement_file (tmp, f, options->backup) != 0)
+    {
+      *report = lu_batch_failure (N_("could not write `%s'"), f, errno);
+      err = 1;
+    }
+  if (err)
+    remove (tmp);
+  else if (options->quiet == 0)
+    *report = xasprintf (N_("%s -> Boilerplate applied."), f);
+  free (tmp);
+  return err;
+}
+
+int 
+lu_image_apply (struct lu_state_t *state, struct lu_image_apply_options_t *options)
+{
+  int err = 0;
+  if (!can_apply(image_apply.name))
+    return -1;
+
+  struct lu_preview_options_t preview_options;
+  memset (&preview_options, 0, sizeof (preview_options));
+  preview_options.state = state;
+  preview_options.no_style = 1;
+  char *boilerplate = get_boilerplate_file (state, &preview_options);
+  if (!boilerplate)
+    return -2;
+
+  FILE *fileptr = fopen (boilerplate, "r");
+  free_boilerplate_file (boilerplate);
+  if (!fileptr)
+    return -2;
+  options->data_len = 0;
+  int more = 0;
+  options->data = lu_read_head (fileptr, &options->data_len, &more);
+  fclose (fileptr);
+  if (!options->data || more)
+    {
+      error (0, 0, N_("the boilerplate is bigger than the memory budget"));
+      free (options->data);
+      return -2;
+    }
+
+  char *files = NULL;
+  size_t files_len = 0;
+  char *f = NULL;
+  while ((f = argz_next (options->input_files, options->input_files_len, f)))
+    {
+      if (lu_collect_files_with_suffixes (f, options->recursive,
+                                          lu_image_suffixes, &files,
+                                          &files_len))
+        err = -1;
+    }
+  if (lu_batch (state, files, files_len, options->jobs, save_comment, options))
+    err = -1;
+  free (files);
+  free (options->data);
+  return err;
+}
+
+struct lu_command_t image_apply = 
+{
+  .name         = N_("image-apply"),
+  .doc          = IMAGE_APPLY_DOC,
+  .flags        = DO_NOT_SHOW_IN_HELP | SAVE_IN_HISTORY,
+  .argp         = &argp,
+  .parser       = lu_image_apply_parse_argp
+};
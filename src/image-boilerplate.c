@@ -0,0 +1,256 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <argz.h>
+#include "licensing_priv.h"
+#include "image-boilerplate.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "util.h"
+#include "image-formats.h"
+#include "batch.h"
+
+static struct argp_option argp_options[] = 
+{
+    {"remove", 'r', NULL, 0, N_("remove the comment in FILE")},
+    {"no-backup", 'n', NULL, 0, N_("don't save .bak files when removing boilerplate")},
+    {"force", 'f', NULL, 0, N_("force the removal copyright notices")},
+    {"recursive", 'R', NULL, 0,
+      N_("look at the image files in directories too")},
+    {"jobs", 'j', "NUM", 0, N_("work on NUM files at a time")},
+    {0}
+};
+
+static error_t 
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  struct lu_image_boilerplate_options_t *opt = NULL;
+  if (state)
+    opt = (struct lu_image_boilerplate_options_t*) state->input;
+  switch (key)
+    {
+    case 'f':
+      opt->force = 1;
+      break;
+    case 'n':
+      opt->no_backups = 1;
+      break;
+    case 'r':
+      opt->remove = 1;
+      break;
+    case 'R':
+      opt->recursive = 1;
+      break;
+    case 'j':
+      opt->jobs = lu_batch_parse_jobs (arg);
+      if (opt->jobs == -1)
+        {
+          argp_failure (state, 0, 0,
+                        N_("`%s' is an invalid number of jobs"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    case ARGP_KEY_ARG:
+        argz_add (&opt->input_files, &opt->input_files_len, arg);
+      break;
+    case ARGP_KEY_INIT:
+      opt->remove = 0;
+      opt->no_backups = 0;
+      opt->force = 0;
+      opt->recursive = 0;
+      opt->jobs = lu_batch_default_jobs ();
+      opt->input_files = NULL;
+      opt->input_files_len = 0;
+      break;
+    case ARGP_KEY_FINI:
+      if (opt->no_backups && !opt->remove)
+        {
+          argp_failure (state, 0, 0, 
+                        N_("--no-backup can only be used with --remove"));
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      if (opt->force && !opt->remove)
+        {
+          argp_failure (state, 0, 0, 
+                        N_("--force can only be used with --remove"));
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+#undef IMAGE_BOILERPLATE_DOC
+#define IMAGE_BOILERPLATE_DOC \
+  N_("Show or remove the comment in PNG, JPEG, GIF or SVG files.") "\v"\
+  N_("The kind of image is worked out from the start of each file.")
+static struct argp argp = { argp_options, parse_opt, "FILE...", IMAGE_BOILERPLATE_DOC};
+
+int 
+lu_image_boilerplate_parse_argp (struct lu_state_t *state, int argc, char **argv)
+{
+  int err = 0;
+  struct lu_image_boilerplate_options_t opts;
+  opts.state = state;
+
+  err = argp_parse (&argp, argc, argv, state->argp_flags,  0, &opts);
+  if (!err)
+    return lu_image_boilerplate (state, &opts);
+  else
+    return err;
+}
+
+static int
+get_comment (struct lu_image_format_t *format, FILE *fp, char *f, char **comment, char **report)
+{
+  int err = format->get_comment (fp, comment);
+  if (err == LU_IMAGE_MALFORMED)
+    *report = xasprintf (N_("`%s' is not a %s file"), f, format->name);
+  else if (err)
+    *report = lu_batch_failure (N_("could not open `%s' for reading"), f,
+                                errno);
+  return err;
+}
+
+static int
+contains_copyright (char *text)
+{
+  if (g_regex_match_simple ("[Cc]opyright.*(19[0-9][0-9]|20[0-9][0-9])", text, 
+                            G_REGEX_CASELESS, 0))
+    return 1;
+  return 0;
+}
+
+static int
+remove_comment (struct lu_image_boilerplate_options_t *options, struct lu_image_format_t *format, char *f, FILE *fp, char **report)
+{
+  char *text = NULL;
+  int err = get_comment (format, fp, f, &text, report);
+  if (err)
+    return err;
+  //without a comment there's nothing to remove, so the file is left alone.
+  if (!text)
+    return 0;
+  int copyright = contains_copyright (text);
+  free (text);
+  if (copyright && !options->force)
+    {
+      *report = xasprintf (N_("`%s' contains copyright notices.  "
+                              "use --force to remove them."), f);
+      return 1;
+    }
+  rewind (fp);
+  char *tmp = NULL;
+  FILE *out = open_replacement_file (f, &tmp);
+  if (!out)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), tmp,
+                                  errno);
+      free (tmp);
+      return 1;
+    }
+  err = format->splice_comment (fp, out, NULL, 0, 0);
+  if (fclose (out) != 0 && !err)
+    err = -1;
+  if (err == LU_IMAGE_MALFORMED)
+    *report = xasprintf (N_("`%s' is not a %s file"), f, format->name);
+  else if (err)
+    *report = lu_batch_failure (N_("could not write `%s'"), tmp, errno);
+  else if (commit_replacement_file (tmp, f, !options->no_backups) != 0)
+    {
+      *report = lu_batch_failure (N_("could not write `%s'"), f, errno);
+      err = 1;
+    }
+  if (err)
+    remove (tmp);
+  free (tmp);
+  return err;
+}
+
+static int
+show_or_remove_comment (void *data, char *f, char **output, char **report)
+{
+  struct lu_image_boilerplate_options_t *options = data;
+  if (options->remove && access (f, W_OK) != 0)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), f,
+                                  errno);
+      return 1;
+    }
+  FILE *fp = fopen (f, "rb");
+  if (!fp)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for reading"), f,
+                                  errno);
+      return 1;
+    }
+  struct lu_image_format_t *format = lu_image_format_detect (fp);
+  if (!format)
+    {
+      *report = xasprintf (N_("`%s' is not a PNG, JPEG, GIF or SVG file"), f);
+      fclose (fp);
+      return 1;
+    }
+  int err = 0;
+  if (options->remove)
+    err = remove_comment (options, format, f, fp, report);
+  else
+    {
+      char *comment = NULL;
+      err = get_comment (format, fp, f, &comment, report);
+      if (comment && *comment)
+        *output = xasprintf ("%s\n", comment);
+      free (comment);
+    }
+  fclose (fp);
+  return err;
+}
+
+int 
+lu_image_boilerplate (struct lu_state_t *state, struct lu_image_boilerplate_options_t *options)
+{
+  int err = 0;
+  char *files = NULL;
+  size_t files_len = 0;
+  char *f = NULL;
+  while ((f = argz_next (options->input_files, options->input_files_len, f)))
+    {
+      if (lu_collect_files_with_suffixes (f, options->recursive,
+                                          lu_image_suffixes, &files,
+                                          &files_len))
+        err = -1;
+    }
+  if (lu_batch (state, files, files_len, options->jobs,
+                show_or_remove_comment, options))
+    err = -1;
+  free (files);
+  return err;
+}
+
+struct lu_command_t image_boilerplate = 
+{
+  .name         = N_("image-boilerplate"),
+  .doc          = IMAGE_BOILERPLATE_DOC,
+  .flags        = DO_NOT_SHOW_IN_HELP | SAVE_IN_HISTORY,
+  .argp         = &argp,
+  .parser       = lu_image_boilerplate_parse_argp
+};
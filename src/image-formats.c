@@ -0,0 +1,131 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image-formats.h"
+#include "png-chunks.h"
+#include "jpeg-segments.h"
+#include "gif-blocks.h"
+#include "svg-comments.h"
+
+//this much of the start of a file is looked at to see what it is.
+#define DETECT_SIZE 1024
+
+static int
+png_detect (const unsigned char *buf, size_t len)
+{
+  return len >= 8 && memcmp (buf, "\211PNG\r\n\032\n", 8) == 0;
+}
+
+static int
+png_get_comment (FILE *fp, char **text)
+{
+  *text = NULL;
+  if (lu_png_read_signature (fp) != 0)
+    return LU_IMAGE_MALFORMED;
+  return lu_png_get_comment (fp, text);
+}
+
+static int
+png_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags)
+{
+  if (lu_png_read_signature (fp) != 0)
+    return LU_IMAGE_MALFORMED;
+  int png_flags = 0;
+  if (flags & LU_IMAGE_COMPRESS)
+    png_flags |= LU_PNG_COMPRESS;
+  if (flags & LU_IMAGE_UTF8)
+    png_flags |= LU_PNG_UTF8;
+  return lu_png_splice_comment (fp, out, text, len, png_flags);
+}
+
+static const char *png_suffixes[] = { ".png", NULL };
+static const char *jpeg_suffixes[] = { ".jpg", ".jpeg", NULL };
+static const char *gif_suffixes[] = { ".gif", NULL };
+static const char *svg_suffixes[] = { ".svg", NULL };
+
+static struct lu_image_format_t png_format =
+{
+  .name           = "PNG",
+  .suffixes       = png_suffixes,
+  .detect         = png_detect,
+  .get_comment    = png_get_comment,
+  .splice_comment = png_splice_comment
+};
+
+static struct lu_image_format_t jpeg_format =
+{
+  .name           = "JPEG",
+  .suffixes       = jpeg_suffixes,
+  .detect         = lu_jpeg_detect,
+  .get_comment    = lu_jpeg_get_comment,
+  .splice_comment = lu_jpeg_splice_comment
+};
+
+static struct lu_image_format_t gif_format =
+{
+  .name           = "GIF",
+  .suffixes       = gif_suffixes,
+  .detect         = lu_gif_detect,
+  .get_comment    = lu_gif_get_comment,
+  .splice_comment = lu_gif_splice_comment
+};
+
+static struct lu_image_format_t svg_format =
+{
+  .name           = "SVG",
+  .suffixes       = svg_suffixes,
+  .detect_file    = lu_svg_detect,
+  .get_comment    = lu_svg_get_comment,
+  .splice_comment = lu_svg_splice_comment
+};
+
+//svg goes last because it's the only one without a signature.
+struct lu_image_format_t *lu_image_formats[] =
+{
+  &png_format, &jpeg_format, &gif_format, &svg_format, NULL
+};
+
+const char *lu_image_suffixes[] =
+{
+  ".png", ".jpg", ".jpeg", ".gif", ".svg", NULL
+};
+
+struct lu_image_format_t *
+lu_image_format_detect (FILE *fp)
+{
+  unsigned char buf[DETECT_SIZE];
+  size_t len = fread (buf, 1, sizeof (buf), fp);
+  rewind (fp);
+  for (int i = 0; lu_image_formats[i]; i++)
+    {
+      struct lu_image_format_t *format = lu_image_formats[i];
+      int found;
+      if (format->detect)
+        found = format->detect (buf, len);
+      else
+        {
+          found = format->detect_file (fp);
+          rewind (fp);
+        }
+      if (found)
+        return format;
+    }
+  return NULL;
+}
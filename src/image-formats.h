@@ -0,0 +1,58 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_IMAGE_FORMATS_H
+#define LU_IMAGE_FORMATS_H 1
+
+#include <config.h>
+#include <stdio.h>
+
+//the comment functions return this when the file isn't laid out like
+//the format says it should be.
+#define LU_IMAGE_MALFORMED 1
+
+//the flags for splicing a comment into a png file.
+#define LU_IMAGE_COMPRESS 0x1
+#define LU_IMAGE_UTF8     0x2
+
+struct lu_image_format_t
+{
+  const char *name;
+  //what the files are called, for when we look in directories.
+  const char **suffixes;
+  //check the start of a file, which is LEN bytes long in BUF.
+  int (*detect) (const unsigned char *buf, size_t len);
+  //or, for a format without a signature, read as much of FP as it takes.
+  int (*detect_file) (FILE *fp);
+  //put the comment of the image at FP into *TEXT, or NULL if there
+  //isn't one.  FP is at the start of the file.
+  int (*get_comment) (FILE *fp, char **text);
+  //copy the image at FP to OUT without decoding it, putting TEXT in as
+  //the comment instead of the ones that are there.  when TEXT is NULL the
+  //comments are just taken out.  FP is at the start of the file.
+  int (*splice_comment) (FILE *fp, FILE *out, const char *text, size_t len, int flags);
+};
+
+extern struct lu_image_format_t *lu_image_formats[];
+
+//the suffixes of all of the formats.
+extern const char *lu_image_suffixes[];
+
+//figure out the format of the image at FP from the start of it.
+//returns NULL if it isn't one we know about.  FP is rewound.
+struct lu_image_format_t * lu_image_format_detect (FILE *fp);
+#endif
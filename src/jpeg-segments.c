@@ -0,0 +1,221 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jpeg-segments.h"
+#include "image-formats.h"
+#include "util.h"
+
+/* jpeg files are a list of segments that start with a 0xff byte and a
+   marker byte.  most of them have a 2 byte length after that, which
+   counts itself.  after the start of scan segment comes the compressed
+   image, which goes on until the end, so once we get there the rest of
+   the file can be copied without looking at it. */
+
+#define SOI 0xd8
+#define EOI 0xd9
+#define SOS 0xda
+#define COM 0xfe
+#define APP0 0xe0
+#define APP15 0xef
+
+//the most that can go into one segment.
+#define MAX_SEGMENT_DATA 65533
+
+int
+lu_jpeg_detect (const unsigned char *buf, size_t len)
+{
+  return len >= 3 && buf[0] == 0xff && buf[1] == SOI && buf[2] == 0xff;
+}
+
+static int
+has_length (int marker)
+{
+  return !(marker == SOI || marker == EOI || marker == 0x01 ||
+           (marker >= 0xd0 && marker <= 0xd7));
+}
+
+//read the next marker, and the length of what comes after it.
+static int
+read_segment (FILE *fp, int *marker, size_t *len)
+{
+  int c = getc (fp);
+  if (c != 0xff)
+    return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+  //there can be any number of 0xff bytes before the marker.
+  while ((c = getc (fp)) == 0xff)
+    ;
+  if (c == EOF)
+    return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+  *marker = c;
+  *len = 0;
+  if (has_length (c))
+    {
+      int hi = getc (fp);
+      int lo = getc (fp);
+      if (lo == EOF)
+        return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+      size_t length = (hi << 8) | lo;
+      if (length < 2)
+        return LU_IMAGE_MALFORMED;
+      *len = length - 2;
+    }
+  return 0;
+}
+
+static int
+write_segment_header (FILE *out, int marker, size_t len)
+{
+  putc (0xff, out);
+  putc (marker, out);
+  if (has_length (marker))
+    {
+      putc (((len + 2) >> 8) & 0xff, out);
+      putc ((len + 2) & 0xff, out);
+    }
+  return ferror (out) ? -1 : 0;
+}
+
+static int
+copy_bytes (FILE *fp, FILE *out, size_t len)
+{
+  char buf[65536];
+  while (len > 0)
+    {
+      size_t want = len < sizeof (buf) ? len : sizeof (buf);
+      size_t n = fread (buf, 1, want, fp);
+      if (n != want)
+        return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+      if (fwrite (buf, 1, n, out) != n)
+        return -1;
+      len -= n;
+    }
+  return 0;
+}
+
+//long comments are split over as many segments as it takes.
+static int
+write_comment (FILE *out, const char *text, size_t len)
+{
+  do
+    {
+      size_t n = len < MAX_SEGMENT_DATA ? len : MAX_SEGMENT_DATA;
+      write_segment_header (out, COM, n);
+      if (fwrite (text, 1, n, out) != n)
+        return -1;
+      text += n;
+      len -= n;
+    }
+  while (len > 0);
+  return 0;
+}
+
+int
+lu_jpeg_get_comment (FILE *fp, char **text)
+{
+  *text = NULL;
+  if (getc (fp) != 0xff || getc (fp) != SOI)
+    return LU_IMAGE_MALFORMED;
+  size_t text_len = 0;
+  while (1)
+    {
+      int marker;
+      size_t len;
+      int err = read_segment (fp, &marker, &len);
+      if (err)
+        {
+          free (*text);
+          *text = NULL;
+          return err;
+        }
+      if (marker != COM && *text)
+        break;
+      if (marker == SOS || marker == EOI)
+        break;
+      if (marker == COM)
+        {
+          //a comment that won't fit in the memory budget comes back empty.
+          if (text_len + len > lu_get_memory_budget ())
+            {
+              free (*text);
+              *text = strdup ("");
+              return *text ? 0 : -1;
+            }
+          //comments that follow each other are one long comment.
+          char *bigger = realloc (*text, text_len + len + 1);
+          if (!bigger)
+            {
+              free (*text);
+              *text = NULL;
+              return -1;
+            }
+          *text = bigger;
+          if (fread (&(*text)[text_len], 1, len, fp) != len)
+            {
+              free (*text);
+              *text = NULL;
+              return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+            }
+          text_len += len;
+          (*text)[text_len] = '\0';
+        }
+      else if (fseeko (fp, len, SEEK_CUR) != 0)
+        return -1;
+    }
+  return 0;
+}
+
+int
+lu_jpeg_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags)
+{
+  if (getc (fp) != 0xff || getc (fp) != SOI)
+    return LU_IMAGE_MALFORMED;
+  write_segment_header (out, SOI, 0);
+  int written = text == NULL;
+  while (1)
+    {
+      int marker;
+      size_t seg_len;
+      int err = read_segment (fp, &marker, &seg_len);
+      if (err)
+        return err;
+      if (marker == COM)
+        {
+          if (fseeko (fp, seg_len, SEEK_CUR) != 0)
+            return -1;
+          continue;
+        }
+      //the comment goes after the APPn segments, so that the JFIF or
+      //Exif one stays first.
+      if (!written && !(marker >= APP0 && marker <= APP15))
+        {
+          if (write_comment (out, text, len) != 0)
+            return -1;
+          written = 1;
+        }
+      if (write_segment_header (out, marker, seg_len) != 0)
+        return -1;
+      err = copy_bytes (fp, out, seg_len);
+      if (err)
+        return err;
+      if (marker == SOS || marker == EOI)
+        break;
+    }
+  return copy_rest_of_file (fp, out);
+}
@@ -31,6 +31,7 @@
 #include "trim.h"
 #include "xvasprintf.h"
 #include "progname.h"
+#include "util.h"
 
 #include "opts.h"
 #include "gpl.h"
@@ -59,17 +60,27 @@
 #include "apache.h"
 #include "isc.h"
 #include "styles.h"
+#include "result-cache.h"
+#include "scan-cache.h"
 #include "prepend.h"
 #include "preview.h"
 #include "detect.h"
 #include "forget.h"
+#include "update-years.h"
+#include "image-boilerplate.h"
+#include "image-apply.h"
+#include "watch.h"
+#include "report.h"
+#include "check.h"
+#include "stats.h"
 
 enum 
 {
   NOTICE = 0, GPL, LGPL, AGPL, FDL, BOILERPLATE, HELP, WARRANTY, WELCOME, 
   COPYRIGHT, CBB, COMMENT, UNCOMMENT, PREPEND, CHOOSE, TOP, PROJECT,
   PREVIEW, APPLY, NEW_BOILERPLATE, ALL_PERMISSIVE, BSD, APACHE, MIT, 
-  EXTRA, PNG_BOILERPLATE, PNG_APPLY, ISC, DETECT, FORGET, THE_END
+  EXTRA, PNG_BOILERPLATE, PNG_APPLY, ISC, DETECT, FORGET, UPDATE_YEARS,
+  IMAGE_BOILERPLATE, IMAGE_APPLY, WATCH, REPORT, CHECK, THE_END
 };
 
 struct lu_command_t notice = 
@@ -114,6 +125,12 @@ struct lu_command_t* lu_commands[]=
   [NOTICE]          = &notice,
   [DETECT]          = &detect,
   [FORGET]          = &forget,
+  [UPDATE_YEARS]    = &update_years,
+  [IMAGE_BOILERPLATE] = &image_boilerplate,
+  [IMAGE_APPLY]     = &image_apply,
+  [WATCH]           = &watch,
+  [REPORT]          = &report,
+  [CHECK]           = &check,
   [THE_END]     = NULL
 };
 
@@ -195,7 +212,10 @@ lu_parse_command (struct lu_state_t *state, char *line)
       else
         {
           char *c = xasprintf ("%s/%s", BINDIR, line);
+          lu_stats_add (LU_STATS_SPAWNS, 1);
+          gint64 start = lu_stats_start ();
           err = system (c);
+          lu_stats_stop (LU_STATS_SPAWN_TIME, start);
           free (c);
         }
       for (int i = 0; i < argc; i++)
@@ -245,6 +265,16 @@ lu_init (struct lu_options_t *arguments)
   state->curl = curl_easy_init();
 
   state->out = stdout;
+  lu_init_comment_styles ();
+  lu_stats_enable (arguments->stats);
+  lu_result_cache_init (arguments->result_cache);
+  lu_scan_cache_init (arguments->scan_cache);
+  lu_set_memory_budget (arguments->memory_budget);
+  //output going to a file or a pipe is written in big blocks instead of
+  //a line at a time.
+  static char out_buffer[256 * 1024];
+  if (!isatty (fileno (stdout)))
+    setvbuf (stdout, out_buffer, _IOFBF, sizeof (out_buffer));
 
   char *dir = xasprintf ("%s/.%s", getenv("HOME"), PACKAGE);
   DIR *d = opendir (dir);
@@ -268,6 +298,9 @@ lu_destroy(struct lu_state_t *state)
 {
   curl_easy_cleanup(state->curl);
   curl_global_cleanup();
+  fflush (state->out);
+  lu_scan_cache_save ();
+  lu_stats_show (stderr);
   free (state);
 }
 
@@ -481,9 +514,25 @@ luprintf (struct lu_state_t *state, char *fmt, ...)
   va_start (ap, fmt);
   int r = vfprintf (state->out, fmt, ap);
   va_end(ap);
+  if (r > 0)
+    lu_stats_add (LU_STATS_BYTES_WRITTEN, r);
   return r;
 }
 
+int
+luwrite (struct lu_state_t *state, const char *buf, size_t len)
+{
+  lu_stats_add (LU_STATS_BYTES_WRITTEN, len);
+  return fwrite (buf, 1, len, state->out) == len ? 0 : -1;
+}
+
+//copy the rest of FP to the output.
+int
+lucopy (struct lu_state_t *state, FILE *fp)
+{
+  return copy_rest_of_file (fp, state->out);
+}
+
 int
 is_a_file (char *filename)
 {
@@ -511,6 +560,7 @@ lu_dump_command_to_file (struct lu_state_t *state, char *command)
   snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
   int fd = mkstemp(tmp);
   close (fd);
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
   FILE *fileptr = fopen (tmp, "w");
   FILE *oldout = state->out;
   state->out = fileptr;
@@ -26,6 +26,10 @@
 struct lu_options_t
 {
   int quiet;
+  int stats; //show counters and timers at exit, see stats.h
+  int result_cache; //keep the results in result-cache.h on disk too
+  char *scan_cache; //where scan-cache.h keeps what it finds, or NULL
+  size_t memory_budget; //how much of a file is kept in memory, see util.h
   char *command_on_argv; //run a single command and exit
   size_t command_on_argv_len;
 };
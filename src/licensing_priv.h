@@ -24,6 +24,8 @@
 
 int argp_help_check (int argc, char **argv);
 int luprintf (struct lu_state_t *state, char *fmt, ...);
+int luwrite (struct lu_state_t *state, const char *buf, size_t len);
+int lucopy (struct lu_state_t *state, FILE *fp);
 int lu_parse_command (struct lu_state_t *state, char *line);
 char *lu_list_of_commands_for_help(int show_all);
 void lu_generate_bashrc_file (FILE *fp);
@@ -23,10 +23,14 @@
 #include <argp.h>
 #include <argz.h>
 #include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
 #include "xvasprintf.h"
 #include "gettext-more.h"
 #include "opts.h"
 #include "licensing_priv.h"
+#include "stats.h"
+#include "util.h"
 
 #define FULL_VERSION PROGRAM " " PACKAGE_VERSION
 
@@ -37,6 +41,10 @@ struct arguments_t arguments;
 static struct argp_option options[] = 
 {
     { "quiet", OPT_QUIET, NULL, 0, N_("don't show the welcome message") },
+    { "stats", OPT_STATS, "FORMAT", OPTION_ARG_OPTIONAL, N_("show where the time went on stderr at exit, as text or json") },
+    { "result-cache", OPT_RESULT_CACHE, NULL, 0, N_("keep what detect, uncomment and update-years work out from each file header in ~/.licenseutils/result-cache for later runs") },
+    { "scan-cache", OPT_SCAN_CACHE, "FILE", OPTION_ARG_OPTIONAL, N_("don't read the files again that haven't changed since the last run, by keeping what cbb, boilerplate and detect find in FILE (default ~/.licenseutils/scan-cache)") },
+    { "memory-budget", OPT_MEMORY_BUDGET, "SIZE", 0, N_("keep at most SIZE bytes of any one file in memory, like 64k or 8M (default 8M)") },
     { "generate-bashrc", OPT_BASH, NULL, OPTION_HIDDEN, N_("generate a bashrc file and exit") },
     { 0 }
 };
@@ -45,11 +53,49 @@ static void
 init_options (struct lu_options_t *app)
 {
   app->quiet = -1;
+  app->stats = LU_STATS_OFF;
+  app->result_cache = 0;
+  app->scan_cache = NULL;
+  app->memory_budget = LU_DEFAULT_MEMORY_BUDGET;
   app->command_on_argv = NULL;
   app->command_on_argv_len = 0;
   return;
 }
 
+//a number of bytes, or of kilobytes, megabytes or gigabytes with a k, M
+//or G after it.  returns 0 when ARG isn't one.
+static size_t
+parse_size (char *arg)
+{
+  char *end = NULL;
+  errno = 0;
+  unsigned long long size = strtoull (arg, &end, 10);
+  if (end == arg || errno || arg[0] == '-')
+    return 0;
+  int shift = 0;
+  switch (*end)
+    {
+    case 'k': case 'K':
+      shift = 10;
+      break;
+    case 'm': case 'M':
+      shift = 20;
+      break;
+    case 'g': case 'G':
+      shift = 30;
+      break;
+    case '\0':
+      break;
+    default:
+      return 0;
+    }
+  if (shift && end[1] != '\0')
+    return 0;
+  if (size > (SIZE_MAX >> shift))
+    return 0;
+  return size << shift;
+}
+
 static error_t 
 parse_opt (int key, char *arg, struct argp_state *state) 
 {
@@ -60,6 +106,26 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case OPT_QUIET:
       arguments->lu.quiet = 1;
       break;
+    case OPT_STATS:
+      if (arg == NULL || strcmp (arg, "text") == 0)
+        arguments->lu.stats = LU_STATS_TEXT;
+      else if (strcmp (arg, "json") == 0)
+        arguments->lu.stats = LU_STATS_JSON;
+      else
+        argp_error (state, N_("`%s' is not text or json"), arg);
+      break;
+    case OPT_RESULT_CACHE:
+      arguments->lu.result_cache = 1;
+      break;
+    case OPT_SCAN_CACHE:
+      arguments->lu.scan_cache = arg ? arg : "";
+      break;
+    case OPT_MEMORY_BUDGET:
+      arguments->lu.memory_budget = parse_size (arg);
+      if (arguments->lu.memory_budget < LU_MIN_MEMORY_BUDGET)
+        argp_error (state, N_("`%s' is not a memory budget of at least %dk"),
+                    arg, LU_MIN_MEMORY_BUDGET / 1024);
+      break;
     case ARGP_KEY_INIT:
       init_options (&arguments->lu);
       break;
@@ -23,6 +23,10 @@
 enum app_command_line_options_t
 {
   OPT_BASH = -511,
+  OPT_STATS,
+  OPT_RESULT_CACHE,
+  OPT_SCAN_CACHE,
+  OPT_MEMORY_BUDGET,
   OPT_QUIET = 'q',
 };
 
@@ -19,22 +19,27 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <argz.h>
-#include <png.h>
 #include "licensing_priv.h"
 #include "png-apply.h"
 #include "gettext-more.h"
-#include "read-file.h"
 #include "xvasprintf.h"
-#include "copy-file.h"
 #include "error.h"
 #include "util.h"
 #include "preview.h"
+#include "png-chunks.h"
+#include "batch.h"
 
 static struct argp_option argp_options[] = 
 {
     {"no-backup", 'n', NULL, 0, 
       N_("don't retain original png file in a .bak file")},
     {"quiet", 'q', NULL, 0, N_("don't show diagnostic messages")},
+    {"recursive", 'R', NULL, 0,
+      N_("apply to the .png files in directories too")},
+    {"jobs", 'j', "NUM", 0, N_("work on NUM files at a time")},
+    {"compress", 'z', NULL, 0, N_("store the comment compressed")},
+    {"utf8", 'u', NULL, 0,
+      N_("store the comment as UTF-8 even if it is plain ASCII")},
     {0}
 };
 
@@ -52,6 +57,24 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case 'n':
       opt->backup = 0;
       break;
+    case 'R':
+      opt->recursive = 1;
+      break;
+    case 'z':
+      opt->compress = 1;
+      break;
+    case 'u':
+      opt->utf8 = 1;
+      break;
+    case 'j':
+      opt->jobs = lu_batch_parse_jobs (arg);
+      if (opt->jobs == -1)
+        {
+          argp_failure (state, 0, 0,
+                        N_("`%s' is an invalid number of jobs"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
     case ARGP_KEY_ARG:
       argz_add (&opt->input_files, &opt->input_files_len, arg);
       break;
@@ -60,6 +83,10 @@ parse_opt (int key, char *arg, struct argp_state *state)
       opt->input_files_len = 0;
       opt->backup = 1;
       opt->quiet = 0;
+      opt->recursive = 0;
+      opt->jobs = lu_batch_default_jobs ();
+      opt->compress = 0;
+      opt->utf8 = 0;
       break;
     case ARGP_KEY_FINI:
       if (opt->input_files == NULL)
@@ -76,7 +103,8 @@ parse_opt (int key, char *arg, struct argp_state *state)
 
 
 #undef PNG_APPLY_DOC
-#define PNG_APPLY_DOC N_("Put the current working boilerplate into a PNG file.")
+#define PNG_APPLY_DOC N_("Put the current working boilerplate into a PNG file.") "\v"\
+  N_("With --recursive, the .png files in directories are done too.")
 static struct argp argp = { argp_options, parse_opt, "FILE...", PNG_APPLY_DOC};
 
 int 
@@ -93,167 +121,63 @@ lu_png_apply_parse_argp (struct lu_state_t *state, int argc, char **argv)
     return err;
 }
 
-static void 
-nowarn (png_structp png, const char *msg)
+static int
+save_comment (void *data, char *f, char **output, char **report)
 {
-  return;
-}
-static void
-save_comment (FILE *fp, FILE *out, char *data, size_t data_len)
-{
-  //setup out file
-  png_bytepp row_pointers = NULL;
-  int i, rowbytes;
-  png_structp outpng = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, nowarn);
-  setjmp (png_jmpbuf (outpng));
-  png_init_io (outpng, out);
-  png_set_expand (outpng);
-
-  //setup in file
-  png_structp inpng = png_create_read_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-  png_infop ininfo = png_create_info_struct (inpng);
-  png_init_io (inpng, fp);
-
-  //get data from in file
-  unsigned char *raster = NULL;
-  int channels = 0;
-  unsigned int width = 0;
-  unsigned int height = 0;
-  int bitdepth = 0;
-  int colourtype = 0;
-  png_set_sig_bytes(inpng, 8);
-  png_read_info (inpng, ininfo);
-  png_get_IHDR (inpng, ininfo, &width, &height, &bitdepth, &colourtype, NULL, 
-               NULL, NULL);
-
-  if(bitdepth < 8)
-    png_set_packing (inpng);
-
-  if (colourtype == PNG_COLOR_TYPE_PALETTE)
-    png_set_expand (inpng);
-
-  int num_text = 0;
-  png_textp text_ptr;
-  if (png_get_text (inpng, ininfo, &text_ptr, &num_text) > 0)
+  struct lu_png_apply_options_t *options = data;
+  if (access (f, W_OK) != 0)
     {
-      text_ptr = realloc (text_ptr, sizeof (png_text) * (num_text + 1));
-      memmove (text_ptr + sizeof (png_text), text_ptr, sizeof (png_text) * num_text);
-      memset (text_ptr, 0, sizeof (png_text));
-      text_ptr->key = strdup ("Comment");
-      text_ptr->text = data;
-      text_ptr->text_length = data_len;
-      text_ptr->compression = PNG_TEXT_COMPRESSION_NONE;
-#ifdef PNG_iTXt_SUPPORTED
-      text_ptr->itxt_length = 0;
-      text_ptr->lang = NULL;
-      text_ptr->lang_key = NULL;
-#endif
-      png_set_text (inpng, ininfo, text_ptr, num_text);
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), f,
+                                  errno);
+      return 1;
     }
-  else
+  FILE *fp = fopen (f, "rb");
+  if (!fp)
     {
-      //png_data_freer (inpng, ininfo, PNG_USER_WILL_FREE_DATA, PNG_FREE_TEXT);
-      text_ptr = malloc (sizeof (png_text));
-      memset (text_ptr, 0, sizeof (png_text));
-      text_ptr->key = strdup ("Comment");
-      text_ptr->text = data;
-      text_ptr->text_length = data_len;
-      text_ptr->compression = PNG_TEXT_COMPRESSION_NONE;
-#ifdef PNG_iTXt_SUPPORTED
-      text_ptr->itxt_length = 0;
-      text_ptr->lang = NULL;
-      text_ptr->lang_key = NULL;
-#endif
-      png_set_text (inpng, ininfo, text_ptr, 1);
+      *report = lu_batch_failure (N_("could not open `%s' for reading"), f,
+                                  errno);
+      return 1;
     }
-  png_read_update_info (inpng, ininfo);
-  channels = png_get_channels (inpng, ininfo);
-
-  rowbytes = png_get_rowbytes (inpng, ininfo);
-  row_pointers = malloc (height * sizeof (png_bytep));
-  raster = (unsigned char *) malloc ((rowbytes * height) + 1);
-
-  for (i = 0; i < height; ++i)
-    row_pointers[i] = raster + (i * rowbytes);
-  png_read_image (inpng, row_pointers);
-
-
-  //now write it all out
-
-  png_write_info (outpng, ininfo);
-  rowbytes = bitdepth / 8;
-  if (bitdepth % 8 != 0)
-    rowbytes++;
-  rowbytes *= channels;
-  rowbytes *= width;
-
-  row_pointers = malloc (height * sizeof (png_bytep));
-  for (i = 0; i < height; ++i)
-    row_pointers[i] = raster + (i * rowbytes);
-
-  png_write_image (outpng, row_pointers);
-
-  png_write_end (outpng, ininfo);
-  png_destroy_write_struct (&outpng, NULL);
-  png_destroy_read_struct (&inpng, &ininfo, NULL);
-}
-
-static int 
-lu_save_comment (struct lu_state_t *state, struct lu_png_apply_options_t *options, char *f, char *text, size_t text_len)
-{
-  int err = 0;
-  unsigned char signature[8];
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fp = fopen (f, "rb");
-  if (fp)
+  if (lu_png_read_signature (fp) != 0)
     {
-      memset (signature, 0, sizeof (signature));
-      if (fread (signature, 1, 8, fp) != 8)
-        {
-          error (0, 0, N_("`%s' is not a PNG file"), f);
-          return 1;
-        }
-      if (png_sig_cmp (signature, 0, 8) != 0)
-        {
-          error (0, 0, N_("`%s' is not a PNG file"), f);
-          return 1;
-        }
+      *report = xasprintf (N_("`%s' is not a PNG file"), f);
+      fclose (fp);
+      return 1;
     }
-  FILE *out = fopen (tmp, "wb");
-  if (fp && out)
-    save_comment (fp, out, text, text_len);
-  fclose (out);
-  fclose (fp);
-  if (options->backup)
+  char *tmp = NULL;
+  FILE *out = open_replacement_file (f, &tmp);
+  if (!out)
     {
-      char *new_filename = xasprintf ("%s.bak", f);
-      err = rename (f, new_filename);
-      if (!err)
-        {
-          err = qcopy_file_preserving (tmp, f);
-          if (err)
-            error (0, errno, N_("couldn't copy %s -> %s"), tmp, f);
-        }
-      else
-        error (0, errno, N_("couldn't move %s -> %s"), f, new_filename);
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), tmp,
+                                  errno);
+      free (tmp);
+      fclose (fp);
+      return 1;
     }
-  else
+  int flags = 0;
+  if (options->compress)
+    flags |= LU_PNG_COMPRESS;
+  if (options->utf8)
+    flags |= LU_PNG_UTF8;
+  int err = lu_png_splice_comment (fp, out, options->data, options->data_len,
+                                   flags);
+  fclose (fp);
+  if (fclose (out) != 0 && !err)
+    err = -1;
+  if (err == LU_PNG_MALFORMED)
+    *report = xasprintf (N_("`%s' is not a PNG file"), f);
+  else if (err)
+    *report = lu_batch_failure (N_("could not write `%s'"), tmp, errno);
+  else if (commit_replacement_file (tmp, f, options->backup) != 0)
     {
-      err = remove (f);
-      if (!err)
-        {
-          err = qcopy_file_preserving (tmp, f);
-          if (err)
-            error (0, errno, N_("couldn't copy %s -> %s"), tmp, f);
-          else
-            err = remove (tmp);
-        }
-      else
-        error (0, errno, N_("couldn't remove `%s'"), f);
+      *report = lu_batch_failure (N_("could not write `%s'"), f, errno);
+      err = 1;
     }
+  if (err)
+    remove (tmp);
+  else if (options->quiet == 0)
+    *report = xasprintf (N_("%s -> Boilerplate applied."), f);
+  free (tmp);
   return err;
 }
 
@@ -264,58 +188,43 @@ lu_png_apply (struct lu_state_t *state, struct lu_png_apply_options_t *options)
   if (!can_apply(png_apply.name))
     return -1;
 
-  char boilerplate[sizeof(PACKAGE) + 13];
-  snprintf (boilerplate, sizeof boilerplate, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp (boilerplate);
-  close (fd);
-  FILE *fp = fopen (boilerplate, "w");
-  if (!fp)
-    {
-      remove (boilerplate);
-      return -2;
-    }
   struct lu_preview_options_t preview_options;
   memset (&preview_options, 0, sizeof (preview_options));
   preview_options.state = state;
   preview_options.no_style = 1;
-  err = generate_boilerplate (state, &preview_options, fp);
-  fclose (fp);
+  char *boilerplate = get_boilerplate_file (state, &preview_options);
+  if (!boilerplate)
+    return -2;
 
   FILE *fileptr = fopen (boilerplate, "r");
-  size_t data_len = 0;
-  char *data = fread_file (fileptr, &data_len);
+  free_boilerplate_file (boilerplate);
+  if (!fileptr)
+    return -2;
+  options->data_len = 0;
+  int more = 0;
+  options->data = lu_read_head (fileptr, &options->data_len, &more);
   fclose (fileptr);
+  if (!options->data || more)
+    {
+      error (0, 0, N_("the boilerplate is bigger than the memory budget"));
+      free (options->data);
+      return -2;
+    }
 
+  const char *suffixes[] = { ".png", NULL };
+  char *files = NULL;
+  size_t files_len = 0;
   char *f = NULL;
   while ((f = argz_next (options->input_files, options->input_files_len, f)))
     {
-      if (is_a_file (f) == 0)
-        {
-          if (errno == EISDIR)
-            error (0, errno, "%s", f);
-          else
-            error (0, errno, N_("could not open `%s' for reading"), f);
-          continue;
-        }
-      else
-        {
-          if (access (f, W_OK) != 0)
-            {
-              error (0, errno, N_("could not open `%s' for writing"), f);
-              continue;
-            }
-        }
-      err = lu_save_comment (state, options, f, data, data_len);
-      if (!err)
-        {
-          if (options->quiet == 0)
-            error (0, 0, N_("%s -> Boilerplate applied."), f);
-        }
-      if (err)
-        break;
+      if (lu_collect_files_with_suffixes (f, options->recursive, suffixes,
+                                          &files, &files_len))
+        err = -1;
     }
-  free (data);
-  remove (boilerplate);
+  if (lu_batch (state, files, files_len, options->jobs, save_comment, options))
+    err = -1;
+  free (files);
+  free (options->data);
   return err;
 }
 
@@ -29,6 +29,12 @@ struct lu_png_apply_options_t
   size_t input_files_len;
   int backup;
   int quiet;
+  int recursive;
+  int jobs;
+  int compress;
+  int utf8;
+  char *data;
+  size_t data_len;
 };
 
 int lu_png_apply_parse_argp (struct lu_state_t *, int argc, char **argv);
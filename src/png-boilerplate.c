@@ -19,19 +19,23 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <argz.h>
-#include <png.h>
 #include "licensing_priv.h"
 #include "png-boilerplate.h"
 #include "gettext-more.h"
 #include "xvasprintf.h"
-#include "copy-file.h"
 #include "error.h"
+#include "util.h"
+#include "png-chunks.h"
+#include "batch.h"
 
 static struct argp_option argp_options[] = 
 {
     {"remove", 'r', NULL, 0, N_("remove the comment in FILE")},
     {"no-backup", 'n', NULL, 0, N_("don't save .bak files when removing boilerplate")},
     {"force", 'f', NULL, 0, N_("force the removal copyright notices")},
+    {"recursive", 'R', NULL, 0,
+      N_("look at the .png files in directories too")},
+    {"jobs", 'j', "NUM", 0, N_("work on NUM files at a time")},
     {0}
 };
 
@@ -52,6 +56,18 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case 'r':
       opt->remove = 1;
       break;
+    case 'R':
+      opt->recursive = 1;
+      break;
+    case 'j':
+      opt->jobs = lu_batch_parse_jobs (arg);
+      if (opt->jobs == -1)
+        {
+          argp_failure (state, 0, 0,
+                        N_("`%s' is an invalid number of jobs"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
     case ARGP_KEY_ARG:
         argz_add (&opt->input_files, &opt->input_files_len, arg);
       break;
@@ -59,6 +75,8 @@ parse_opt (int key, char *arg, struct argp_state *state)
       opt->remove = 0;
       opt->no_backups = 0;
       opt->force = 0;
+      opt->recursive = 0;
+      opt->jobs = lu_batch_default_jobs ();
       opt->input_files = NULL;
       opt->input_files_len = 0;
       break;
@@ -83,7 +101,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
 }
 #undef NEW_BOILERPLATE_DOC
 #define NEW_BOILERPLATE_DOC N_("Show or remove the comment in a png file.") "\v" N_("")
-static struct argp argp = { argp_options, parse_opt, "FILE", NEW_BOILERPLATE_DOC};
+static struct argp argp = { argp_options, parse_opt, "FILE...", NEW_BOILERPLATE_DOC};
 
 int 
 lu_png_boilerplate_parse_argp (struct lu_state_t *state, int argc, char **argv)
@@ -99,56 +117,22 @@ lu_png_boilerplate_parse_argp (struct lu_state_t *state, int argc, char **argv)
     return err;
 }
 
-static char *
-get_comment (FILE *fp, char *f)
+static int
+get_comment (FILE *fp, char *f, char **comment, char **report)
 {
-  char *c = NULL;
-
-  unsigned char signature[8];
-  memset (signature, 0, sizeof (signature));
-  if (fread (signature, 1, 8, fp) != 8)
+  *comment = NULL;
+  if (lu_png_read_signature (fp) != 0)
     {
-      error (0, 0, N_("`%s' is not a PNG file"), f);
-      return NULL;
+      *report = xasprintf (N_("`%s' is not a PNG file"), f);
+      return 1;
     }
-
-  if (png_sig_cmp (signature, 0, 8) != 0)
-    {
-      error (0, 0, N_("`%s' is not a PNG file"), f);
-      return NULL;
-    }
-  rewind (fp);
-  png_structp read_ptr;
-  read_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-  png_init_io (read_ptr, fp);
-
-  png_textp text_ptr;
-  int num_text = 0;
-  png_infop read_info_ptr;
-  read_info_ptr = png_create_info_struct (read_ptr);
-  png_read_info (read_ptr, read_info_ptr);
-  if (png_get_text (read_ptr, read_info_ptr, &text_ptr, &num_text) > 0)
-    {
-      png_text *comment = text_ptr;
-      for (int i = 0; i < num_text; i++)
-        {
-          if (strcmp (comment->key, "Comment") == 0)
-            {
-              if (comment->text && strlen (comment->text) > 0)
-                c = strdup (comment->text);
-              break;
-            }
-          comment++;
-        }
-    }
-  png_destroy_read_struct (&read_ptr, &read_info_ptr, NULL);
-  return c;
-}
-
-static void 
-nowarn (png_structp png, const char *msg)
-{
-  return;
+  int err = lu_png_get_comment (fp, comment);
+  if (err == LU_PNG_MALFORMED)
+    *report = xasprintf (N_("`%s' is not a PNG file"), f);
+  else if (err)
+    *report = lu_batch_failure (N_("could not open `%s' for reading"), f,
+                                errno);
+  return err;
 }
 
 static int
@@ -160,165 +144,82 @@ contains_copyright (char *text)
   return 0;
 }
 
-static void
-remove_comment (FILE *fp, FILE *out)
+static int
+remove_comment (struct lu_png_boilerplate_options_t *options, char *f, FILE *fp, char **report)
 {
-  //setup out file
-  png_bytepp row_pointers = NULL;
-  int i, rowbytes;
-  png_structp outpng = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, nowarn);
-  setjmp (png_jmpbuf (outpng));
-  png_init_io (outpng, out);
-  png_set_expand (outpng);
-
-  //setup in file
-  png_structp inpng = png_create_read_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-  png_infop ininfo = png_create_info_struct (inpng);
-  png_init_io (inpng, fp);
-
-  //get data from in file
-  unsigned char *raster = NULL;
-  int channels = 0;
-  unsigned int width = 0;
-  unsigned int height = 0;
-  int bitdepth = 0;
-  int colourtype = 0;
-  png_set_sig_bytes(inpng, 8);
-  png_read_info (inpng, ininfo);
-  png_get_IHDR (inpng, ininfo, &width, &height, &bitdepth, &colourtype, NULL, 
-               NULL, NULL);
-
-  if(bitdepth < 8)
-    png_set_packing (inpng);
-
-  if (colourtype == PNG_COLOR_TYPE_PALETTE)
-    png_set_expand (inpng);
-
-  //remove the comment!
-  png_textp text_ptr;
-  int num_text = 0;
-  if (png_get_text (inpng, ininfo, &text_ptr, &num_text) > 0)
+  char *text = NULL;
+  int err = get_comment (fp, f, &text, report);
+  if (err)
+    return err;
+  //without a comment there's nothing to remove, so the file is left alone.
+  if (!text)
+    return 0;
+  int copyright = contains_copyright (text);
+  free (text);
+  if (copyright && !options->force)
     {
-      png_text *comment = text_ptr;
-      for (int i = 0; i < num_text; i++)
-        {
-          if (strcmp (comment->key, "Comment") == 0)
-            {
-              if (comment->text)
-                {
-                  strcpy (comment->text, "\n");
-                  comment->text_length = 1;
-                  //comment->itxt_length = 1;
-                  break;
-                }
-            }
-          comment++;
-        }
-    
-      png_set_text (inpng, ininfo, text_ptr, num_text);
+      *report = xasprintf (N_("`%s' contains copyright notices.  "
+                              "use --force to remove them."), f);
+      return 1;
     }
-
-  png_read_update_info (inpng, ininfo);
-  channels = png_get_channels (inpng, ininfo);
-
-  rowbytes = png_get_rowbytes (inpng, ininfo);
-  row_pointers = malloc (height * sizeof (png_bytep));
-  raster = (unsigned char *) malloc ((rowbytes * height) + 1);
-
-  for (i = 0; i < height; ++i)
-    row_pointers[i] = raster + (i * rowbytes);
-  png_read_image (inpng, row_pointers);
-
-  //now write it all out
-
-  png_write_info (outpng, ininfo);
-  rowbytes = bitdepth / 8;
-  if (bitdepth % 8 != 0)
-    rowbytes++;
-  rowbytes *= channels;
-  rowbytes *= width;
-
-  row_pointers = malloc (height * sizeof (png_bytep));
-  for (i = 0; i < height; ++i)
-    row_pointers[i] = raster + (i * rowbytes);
-
-  png_write_image (outpng, row_pointers);
-
-  png_write_end (outpng, ininfo);
-  png_destroy_write_struct (&outpng, NULL);
-  png_destroy_read_struct (&inpng, &ininfo, NULL);
+  rewind (fp);
+  lu_png_read_signature (fp);
+  char *tmp = NULL;
+  FILE *out = open_replacement_file (f, &tmp);
+  if (!out)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), tmp,
+                                  errno);
+      free (tmp);
+      return 1;
+    }
+  err = lu_png_splice_comment (fp, out, NULL, 0, 0);
+  if (fclose (out) != 0 && !err)
+    err = -1;
+  if (err == LU_PNG_MALFORMED)
+    *report = xasprintf (N_("`%s' is not a PNG file"), f);
+  else if (err)
+    *report = lu_batch_failure (N_("could not write `%s'"), tmp, errno);
+  else if (commit_replacement_file (tmp, f, !options->no_backups) != 0)
+    {
+      *report = lu_batch_failure (N_("could not write `%s'"), f, errno);
+      err = 1;
+    }
+  if (err)
+    remove (tmp);
+  free (tmp);
+  return err;
 }
 
 static int
-lu_remove_comment (struct lu_state_t *state, struct lu_png_boilerplate_options_t *options, char *f)
+show_or_remove_comment (void *data, char *f, char **output, char **report)
 {
-  int err = 0;
-  unsigned char signature[8];
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fp = fopen (f, "rb");
-  if (fp)
+  struct lu_png_boilerplate_options_t *options = data;
+  if (options->remove && access (f, W_OK) != 0)
     {
-      char *text = get_comment (fp, f);
-      if (text)
-        {
-          if (contains_copyright (text) && !options->force)
-            {
-              error (0, 0, N_("`%s' contains copyright notices.  "
-                              "use --force to remove them."), f);
-              free (text);
-              return 1;
-            }
-          free (text);
-        }
-      rewind (fp);
-      memset (signature, 0, sizeof (signature));
-      if (fread (signature, 1, 8, fp) != 8)
-        {
-          error (0, 0, N_("`%s' is not a PNG file"), f);
-          return 2;
-        }
-      if (png_sig_cmp (signature, 0, 8) != 0)
-        {
-          error (0, 0, N_("`%s' is not a PNG file"), f);
-          return 3;
-        }
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), f,
+                                  errno);
+      return 1;
     }
-  FILE *out = fopen (tmp, "wb");
-  if (fp && out)
-    remove_comment (fp, out);
-  fclose (out);
-  fclose (fp);
-  if (options->no_backups == 0)
+  FILE *fp = fopen (f, "rb");
+  if (!fp)
     {
-      char *new_filename = xasprintf ("%s.bak", f);
-      if (new_filename)
-        {
-          err = rename (f, new_filename);
-          if (err)
-            error (0, errno, N_("couldn't move %s -> %s"), f, new_filename);
-          else
-            {
-              err = qcopy_file_preserving (tmp, f);
-              if (err)
-                error (0, errno, N_("couldn't copy %s -> %s"), tmp, f);
-            }
-        }
+      *report = lu_batch_failure (N_("could not open `%s' for reading"), f,
+                                  errno);
+      return 1;
     }
+  int err = 0;
+  if (options->remove)
+    err = remove_comment (options, f, fp, report);
   else
     {
-      err = remove (f);
-      if (!err)
-        {
-          err = rename (tmp, f);
-          if (!err)
-            error (0, errno, N_("couldn't move %s - > %s"), tmp, f);
-        }
-      else
-        error (0, errno, N_("couldn't remove `%s'"), f);
+      char *comment = NULL;
+      err = get_comment (fp, f, &comment, report);
+      if (comment && *comment)
+        *output = xasprintf ("%s\n", comment);
+      free (comment);
     }
+  fclose (fp);
   return err;
 }
 
@@ -326,42 +227,20 @@ int
 lu_png_boilerplate (struct lu_state_t *state, struct lu_png_boilerplate_options_t *options)
 {
   int err = 0;
+  const char *suffixes[] = { ".png", NULL };
+  char *files = NULL;
+  size_t files_len = 0;
   char *f = NULL;
   while ((f = argz_next (options->input_files, options->input_files_len, f)))
     {
-      if (is_a_file (f) == 0)
-        {
-          if (errno == EISDIR)
-            error (0, errno, "%s", f);
-          else
-            error (0, errno, N_("could not open `%s' for reading"), f);
-          continue;
-        }
-      if (options->remove == 0)
-        {
-          char *comment = NULL;
-          FILE *fp = fopen(f, "rb");
-          if (fp)
-            {
-              comment = get_comment (fp, f);
-              fclose (fp);
-              if (comment)
-                {
-                  luprintf (state, "%s\n", comment);
-                  free (comment);
-                }
-            }
-        }
-      else
-        {
-          if (access (f, W_OK) != 0)
-            {
-              error (0, errno, N_("could not open `%s' for writing"), f);
-              continue;
-            }
-          err = lu_remove_comment (state, options, f);
-        }
+      if (lu_collect_files_with_suffixes (f, options->recursive, suffixes,
+                                          &files, &files_len))
+        err = -1;
     }
+  if (lu_batch (state, files, files_len, options->jobs,
+                show_or_remove_comment, options))
+    err = -1;
+  free (files);
   return err;
 }
 
@@ -28,6 +28,8 @@ struct lu_png_boilerplate_options_t
   int remove;
   int no_backups;
   int force;
+  int recursive;
+  int jobs;
   char *input_files;
   size_t input_files_len;
 };
@@ -0,0 +1,374 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "png-chunks.h"
+#include "util.h"
+
+/* png files are a signature and then a list of chunks, each of which is
+   a 4 byte length, a 4 byte type, the data, and a crc of the type and the
+   data.  the comment lives in its own chunk, so it can be changed by
+   copying all of the other chunks as they are, and the pixels are never
+   looked at. */
+
+static const unsigned char signature[8] =
+{ 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+static const char comment_keyword[] = "Comment";
+
+int
+lu_png_read_signature (FILE *fp)
+{
+  unsigned char buf[sizeof (signature)];
+  if (fread (buf, 1, sizeof (buf), fp) != sizeof (buf) ||
+      memcmp (buf, signature, sizeof (signature)) != 0)
+    return LU_PNG_MALFORMED;
+  return 0;
+}
+
+static uint32_t
+get_uint32 (const unsigned char *buf)
+{
+  return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+    ((uint32_t) buf[2] << 8) | (uint32_t) buf[3];
+}
+
+static void
+put_uint32 (unsigned char *buf, uint32_t val)
+{
+  buf[0] = (val >> 24) & 0xff;
+  buf[1] = (val >> 16) & 0xff;
+  buf[2] = (val >> 8) & 0xff;
+  buf[3] = val & 0xff;
+}
+
+int
+lu_png_read_chunk_header (FILE *fp, struct lu_png_chunk_t *chunk)
+{
+  unsigned char buf[8];
+  size_t n = fread (buf, 1, sizeof (buf), fp);
+  if (n != sizeof (buf))
+    return ferror (fp) ? -1 : LU_PNG_MALFORMED;
+  chunk->length = get_uint32 (buf);
+  memcpy (chunk->type, &buf[4], 4);
+  chunk->type[4] = '\0';
+  //the length can't be more than 2^31-1 according to the spec.
+  if (chunk->length > 0x7fffffff)
+    return LU_PNG_MALFORMED;
+  for (int i = 0; i < 4; i++)
+    if (!((chunk->type[i] >= 'A' && chunk->type[i] <= 'Z') ||
+          (chunk->type[i] >= 'a' && chunk->type[i] <= 'z')))
+      return LU_PNG_MALFORMED;
+  return 0;
+}
+
+int
+lu_png_write_chunk (FILE *out, const char *type, const unsigned char *data, size_t len)
+{
+  unsigned char buf[8];
+  put_uint32 (buf, len);
+  memcpy (&buf[4], type, 4);
+  uLong crc = crc32 (0, &buf[4], 4);
+  crc = crc32 (crc, data, len);
+  fwrite (buf, 1, sizeof (buf), out);
+  fwrite (data, 1, len, out);
+  put_uint32 (buf, crc);
+  fwrite (buf, 1, 4, out);
+  return ferror (out) ? -1 : 0;
+}
+
+static int
+copy_bytes (FILE *fp, FILE *out, size_t len)
+{
+  char buf[65536];
+  while (len > 0)
+    {
+      size_t want = len < sizeof (buf) ? len : sizeof (buf);
+      size_t n = fread (buf, 1, want, fp);
+      if (n != want)
+        return ferror (fp) ? -1 : LU_PNG_MALFORMED;
+      if (fwrite (buf, 1, n, out) != n)
+        return -1;
+      len -= n;
+    }
+  return 0;
+}
+
+static int
+write_comment_chunk (FILE *out, const char *text, size_t len, int flags)
+{
+  //tEXt and zTXt are latin-1, so anything that isn't plain ascii goes in
+  //as utf-8 in an iTXt chunk with no language tag and no translated keyword.
+  int international = flags & LU_PNG_UTF8;
+  for (size_t i = 0; i < len && !international; i++)
+    if ((unsigned char) text[i] >= 0x80)
+      international = 1;
+  int compressed = flags & LU_PNG_COMPRESS;
+
+  const char *type = "tEXt";
+  size_t header_len = sizeof (comment_keyword);
+  if (international)
+    {
+      type = "iTXt";
+      //compression flag, compression method, and two empty strings.
+      header_len += 4;
+    }
+  else if (compressed)
+    {
+      type = "zTXt";
+      //compression method.
+      header_len += 1;
+    }
+
+  size_t data_len = compressed ? compressBound (len) : len;
+  unsigned char *data = malloc (header_len + data_len);
+  if (!data)
+    return -1;
+  memcpy (data, comment_keyword, sizeof (comment_keyword));
+  memset (&data[sizeof (comment_keyword)], 0,
+          header_len - sizeof (comment_keyword));
+  if (compressed)
+    {
+      uLongf compressed_len = data_len;
+      if (international)
+        data[sizeof (comment_keyword)] = 1;
+      if (compress2 (&data[header_len], &compressed_len,
+                     (const unsigned char *) text, len,
+                     Z_BEST_COMPRESSION) != Z_OK)
+        {
+          free (data);
+          return -1;
+        }
+      data_len = compressed_len;
+    }
+  else
+    memcpy (&data[header_len], text, len);
+  int err = lu_png_write_chunk (out, type, data, header_len + data_len);
+  free (data);
+  return err;
+}
+
+static int
+is_text_chunk (struct lu_png_chunk_t *chunk)
+{
+  return strcmp (chunk->type, "tEXt") == 0 ||
+    strcmp (chunk->type, "zTXt") == 0 || strcmp (chunk->type, "iTXt") == 0;
+}
+
+//the text is read from the start of a text chunk to see if it's the
+//comment, and this is how much of it there is.
+static int
+read_keyword (FILE *fp, struct lu_png_chunk_t *chunk, unsigned char *keyword, size_t *keyword_len)
+{
+  *keyword_len = chunk->length < sizeof (comment_keyword) ? chunk->length
+    : sizeof (comment_keyword);
+  if (fread (keyword, 1, *keyword_len, fp) != *keyword_len)
+    return ferror (fp) ? -1 : LU_PNG_MALFORMED;
+  return 0;
+}
+
+static int
+is_comment (unsigned char *keyword, size_t keyword_len)
+{
+  return keyword_len == sizeof (comment_keyword) &&
+    memcmp (keyword, comment_keyword, sizeof (comment_keyword)) == 0;
+}
+
+//a comment bigger than the memory budget is probably a zlib bomb.
+static char *
+inflate_text (unsigned char *data, size_t len)
+{
+  z_stream z;
+  memset (&z, 0, sizeof (z));
+  if (inflateInit (&z) != Z_OK)
+    return NULL;
+  size_t size = len * 4 + 64;
+  char *text = malloc (size);
+  z.next_in = data;
+  z.avail_in = len;
+  int ret = Z_OK;
+  while (text && ret == Z_OK)
+    {
+      if (z.total_out + 1 >= size)
+        {
+          char *bigger = size < lu_get_memory_budget () ?
+            realloc (text, size * 2) : NULL;
+          if (!bigger)
+            {
+              free (text);
+              text = NULL;
+              break;
+            }
+          text = bigger;
+          size *= 2;
+        }
+      z.next_out = (unsigned char *) &text[z.total_out];
+      z.avail_out = size - z.total_out - 1;
+      ret = inflate (&z, Z_NO_FLUSH);
+    }
+  if (text && ret != Z_STREAM_END)
+    {
+      free (text);
+      text = NULL;
+    }
+  if (text)
+    text[z.total_out] = '\0';
+  inflateEnd (&z);
+  return text;
+}
+
+//DATA is everything in the chunk after the keyword and its nul.
+static char *
+decode_text (struct lu_png_chunk_t *chunk, unsigned char *data, size_t len)
+{
+  if (strcmp (chunk->type, "tEXt") == 0)
+    return strndup ((char *) data, len);
+  else if (strcmp (chunk->type, "zTXt") == 0)
+    {
+      if (len < 1 || data[0] != 0)
+        return NULL;
+      return inflate_text (&data[1], len - 1);
+    }
+  //iTXt has a compression flag and method, and then a language tag and a
+  //translated keyword before the utf-8 text.
+  if (len < 2)
+    return NULL;
+  int compressed = data[0];
+  if (compressed && data[1] != 0)
+    return NULL;
+  unsigned char *p = &data[2];
+  unsigned char *end = data + len;
+  for (int i = 0; i < 2; i++)
+    {
+      p = memchr (p, '\0', end - p);
+      if (!p)
+        return NULL;
+      p++;
+    }
+  if (compressed)
+    return inflate_text (p, end - p);
+  return strndup ((char *) p, end - p);
+}
+
+int
+lu_png_get_comment (FILE *fp, char **text)
+{
+  *text = NULL;
+  while (1)
+    {
+      struct lu_png_chunk_t chunk;
+      int err = lu_png_read_chunk_header (fp, &chunk);
+      if (err)
+        return err;
+      if (strcmp (chunk.type, "IEND") == 0)
+        return 0;
+      size_t skip = chunk.length;
+      if (is_text_chunk (&chunk))
+        {
+          unsigned char keyword[sizeof (comment_keyword)];
+          size_t keyword_len = 0;
+          err = read_keyword (fp, &chunk, keyword, &keyword_len);
+          if (err)
+            return err;
+          //a comment that won't fit in the memory budget comes back empty.
+          if (is_comment (keyword, keyword_len) &&
+              chunk.length - keyword_len > lu_get_memory_budget ())
+            {
+              *text = strdup ("");
+              return *text ? 0 : -1;
+            }
+          if (is_comment (keyword, keyword_len))
+            {
+              size_t len = chunk.length - keyword_len;
+              unsigned char *data = malloc (len + 1);
+              if (!data)
+                return -1;
+              if (fread (data, 1, len, fp) != len)
+                {
+                  free (data);
+                  return ferror (fp) ? -1 : LU_PNG_MALFORMED;
+                }
+              *text = decode_text (&chunk, data, len);
+              free (data);
+              return *text ? 0 : LU_PNG_MALFORMED;
+            }
+          skip -= keyword_len;
+        }
+      //this is how the pixel data gets passed over without reading it.
+      if (fseeko (fp, (off_t) skip + 4, SEEK_CUR) != 0)
+        return -1;
+    }
+}
+
+int
+lu_png_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags)
+{
+  if (fwrite (signature, 1, sizeof (signature), out) != sizeof (signature))
+    return -1;
+  int seen_header = 0;
+  while (1)
+    {
+      struct lu_png_chunk_t chunk;
+      int err = lu_png_read_chunk_header (fp, &chunk);
+      if (err)
+        return err;
+      if (!seen_header && strcmp (chunk.type, "IHDR") != 0)
+        return LU_PNG_MALFORMED;
+
+      //the keyword is at the start of the data, so look at that much of
+      //the text chunks to see if they're the comment.
+      unsigned char keyword[sizeof (comment_keyword)];
+      size_t keyword_len = 0;
+      if (is_text_chunk (&chunk))
+        {
+          err = read_keyword (fp, &chunk, keyword, &keyword_len);
+          if (err)
+            return err;
+          if (is_comment (keyword, keyword_len))
+            {
+              if (fseeko (fp, chunk.length - keyword_len + 4, SEEK_CUR) != 0)
+                return -1;
+              continue;
+            }
+        }
+
+      unsigned char buf[8];
+      put_uint32 (buf, chunk.length);
+      memcpy (&buf[4], chunk.type, 4);
+      if (fwrite (buf, 1, sizeof (buf), out) != sizeof (buf) ||
+          fwrite (keyword, 1, keyword_len, out) != keyword_len)
+        return -1;
+      err = copy_bytes (fp, out, chunk.length - keyword_len + 4);
+      if (err)
+        return err;
+
+      if (!seen_header)
+        {
+          seen_header = 1;
+          if (text && write_comment_chunk (out, text, len, flags) != 0)
+            return -1;
+        }
+      else if (strcmp (chunk.type, "IEND") == 0)
+        break;
+    }
+
+  //keep anything that comes after the end, so that nothing is lost.
+  return copy_rest_of_file (fp, out);
+}
@@ -0,0 +1,56 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_PNG_CHUNKS_H
+#define LU_PNG_CHUNKS_H 1
+
+#include <config.h>
+#include <stdio.h>
+#include <stdint.h>
+
+//the chunk functions return this when the file isn't laid out like a png.
+#define LU_PNG_MALFORMED 1
+
+struct lu_png_chunk_t
+{
+  uint32_t length;
+  char type[5];
+};
+
+//check the signature at the start of FP.  returns 0 if it is a png file.
+int lu_png_read_signature (FILE *fp);
+
+//read the length and type of the next chunk.  FP is left at its data.
+int lu_png_read_chunk_header (FILE *fp, struct lu_png_chunk_t *chunk);
+
+int lu_png_write_chunk (FILE *out, const char *type, const unsigned char *data, size_t len);
+
+//how lu_png_splice_comment stores the comment.
+#define LU_PNG_COMPRESS 0x1 //in a zTXt chunk, or a compressed iTXt one
+#define LU_PNG_UTF8     0x2 //in an iTXt chunk even if it's plain ascii
+
+//copy the png in FP to OUT without decoding it, putting TEXT in as the
+//comment in place of any comments that were there before.  when TEXT is
+//NULL the comments are just taken out.
+//FP must be positioned after the signature.
+int lu_png_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags);
+
+//put the first comment of the png at FP into *TEXT, or NULL if there
+//isn't one.  a comment bigger than the memory budget is given as "".
+//FP must be positioned after the signature.
+int lu_png_get_comment (FILE *fp, char **text);
+#endif
@@ -24,11 +24,11 @@
 #include "prepend.h"
 #include "gettext-more.h"
 #include "xvasprintf.h"
-#include "read-file.h"
 #include "copy-file.h"
 #include "error.h"
 #include "util.h"
 #include "styles.h"
+#include "stats.h"
 
 static struct argp_option argp_options[] = 
 {
@@ -64,6 +64,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
       break;
     case ARGP_KEY_INIT:
       opt->source = NULL;
+      opt->source_data = NULL;
       opt->dest = 0;
       opt->backup = 1;
       opt->style = NULL;
@@ -119,7 +120,9 @@ lu_prepend (struct lu_state_t *state, struct lu_prepend_options_t *options)
   FILE *src = NULL;
   FILE *dst = NULL;
   memset (&st, 0, sizeof (st));
-  if (strcmp (options->source, "-") == 0 || options->source == NULL)
+  if (options->source_data)
+    src = NULL;
+  else if (options->source == NULL || strcmp (options->source, "-") == 0)
     src = stdin;
   else if (is_a_file (options->source) != 0)
     src = fopen (options->source, "r");
@@ -131,18 +134,15 @@ lu_prepend (struct lu_state_t *state, struct lu_prepend_options_t *options)
         error (0, errno, N_("could not open `%s' for reading"), options->source);
       return 1;
     }
-  size_t source_len = 0;
-  char *source = NULL;
-
-  if (src)
-    source = fread_file (src, &source_len);
+  if (!src && !options->source_data)
+    {
+      error (0, errno, N_("could not open `%s' for reading"), options->source);
+      return 1;
+    }
 
-  if (src != stdin && src != NULL)
-    fclose (src);
-  
+  //the source and the rest of the destination are copied straight into
+  //the new file, so neither one has to fit in memory.
   char *comments = NULL;
-  size_t dest_len = 0;
-  char *dest = NULL;
   char *hashbang = NULL;
   if (is_a_file (options->dest) != 0)
     {
@@ -153,8 +153,7 @@ lu_prepend (struct lu_state_t *state, struct lu_prepend_options_t *options)
           if (options->after)
             comments = get_comments_and_whitespace (dst, options->dest, 
                                                     options->style);
-          //the rest
-          dest = fread_file (dst, &dest_len);
+          fstat (fileno (dst), &st);
         }
     }
   else
@@ -163,21 +162,18 @@ lu_prepend (struct lu_state_t *state, struct lu_prepend_options_t *options)
         error (0, errno, "%s", options->dest);
       else
         error (0, errno, N_("could not open `%s' for reading"), options->dest);
+      if (src != stdin && src != NULL)
+        fclose (src);
       return 1;
     }
 
-  if (dst)
-    {
-      fstat (fileno (dst), &st);
-      fclose (dst);
-    }
-
   //okay we have source, and we have dest, and we have hashbang.
   //we might also have comments
   char tmp[sizeof(PACKAGE) + 13];
   snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
   int fd = mkstemp (tmp);
   close (fd);
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
   FILE *out = fopen (tmp, "w");
   if (out)
     {
@@ -185,15 +181,25 @@ lu_prepend (struct lu_state_t *state, struct lu_prepend_options_t *options)
         fprintf (out, "%s", hashbang);
       if (options->after && comments)
         fprintf (out, "%s", comments);
-      fprintf (out, "%s", source);
-      fprintf (out, "%s", dest);
+      if (options->source_data)
+        fprintf (out, "%s", options->source_data);
+      else
+        err = copy_rest_of_file (src, out);
+      if (dst && !err)
+        err = copy_rest_of_file (dst, out);
       fflush (out);
       fsync (fileno (out));
+      lu_stats_add (LU_STATS_FSYNCS, 1);
       fclose (out);
 
-      err = chmod (tmp, st.st_mode);
       if (err)
-        error (0, errno, N_("couldn't chmod %s"), tmp);
+        error (0, errno, N_("couldn't write %s"), tmp);
+      else
+        {
+          err = chmod (tmp, st.st_mode);
+          if (err)
+            error (0, errno, N_("couldn't chmod %s"), tmp);
+        }
 
       if (!err)
         {
@@ -221,8 +227,11 @@ lu_prepend (struct lu_state_t *state, struct lu_prepend_options_t *options)
             error (0, errno, N_("couldn't copy %s -> %s"), tmp, options->dest);
         }
     }
-  free (source);
-  free (dest);
+  if (src != stdin && src != NULL)
+    fclose (src);
+  if (dst)
+    fclose (dst);
+  free (comments);
   free (hashbang);
   return err;
 }
@@ -26,6 +26,7 @@ struct lu_prepend_options_t
 {
   struct lu_state_t *state;
   char *source;
+  char *source_data; //use this instead of reading SOURCE when it's set.
   char *dest;
   int backup;
   struct lu_comment_style_t *style;
@@ -19,7 +19,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <argz.h>
-#include <glib.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "licensing_priv.h"
 #include "preview.h"
 #include "gettext-more.h"
@@ -28,6 +29,10 @@
 #include "trim.h"
 #include "comment.h"
 #include "styles.h"
+#include "formatter.h"
+#include "md2.h"
+#include "error.h"
+#include "stats.h"
 
 enum {
   OPT_NO_STYLE=-1011,
@@ -88,8 +93,7 @@ dump_file (char *file, FILE *out)
   char *data = fread_file (fp, &data_len);
   if (data)
     {
-      fprintf (out, "%s", data);
-      fflush (out);
+      fwrite (data, 1, data_len, out);
       free (data);
     }
   fclose (fp);
@@ -97,23 +101,25 @@ dump_file (char *file, FILE *out)
 }
 
 static int
-format_and_dump_file (char *file, char *fmt, FILE *out)
+format_and_dump_file (char *file, FILE *out)
 {
   FILE *fp = fopen (file, "r");
   if (!fp)
     return -1;
+  size_t data_len = 0;
+  char *data = fread_file (fp, &data_len);
   fclose (fp);
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  char *cmd = xasprintf ("cat %s | %s > %s", file, fmt, tmp);
-  if (cmd)
+  if (data)
     {
-      system (cmd);
-      free (cmd);
-      dump_file (tmp, out);
-      remove (tmp);
+      gint64 start = lu_stats_start ();
+      char *formatted = format_paragraphs (data, FORMATTER_DEFAULT_WIDTH);
+      lu_stats_stop (LU_STATS_FORMAT_TIME, start);
+      if (formatted)
+        {
+          fprintf (out, "%s", formatted);
+          free (formatted);
+        }
+      free (data);
     }
   return 0;
 }
@@ -150,13 +156,13 @@ trim_and_dump_file (char *f, FILE *out)
 }
 
 static int 
-generate_uncommented_boilerplate (struct lu_state_t *state, struct lu_preview_options_t *options, char *fmt, FILE *out)
+generate_uncommented_boilerplate (struct lu_state_t *state, struct lu_preview_options_t *options, FILE *out)
 {
   int err;
   char *f = get_config_file ("top-line");
   if (f)
     {
-      err = format_and_dump_file (f, fmt, out);
+      err = format_and_dump_file (f, out);
       free (f);
       if (!err)
         fprintf (out, "\n");
@@ -172,7 +178,7 @@ generate_uncommented_boilerplate (struct lu_state_t *state, struct lu_preview_op
   f = get_config_file ("project-line");
   if (f)
     {
-      err = format_and_dump_file (f, fmt, out);
+      err = format_and_dump_file (f, out);
       free (f);
       if (!err)
         fprintf (out, "\n");
@@ -186,79 +192,257 @@ generate_uncommented_boilerplate (struct lu_state_t *state, struct lu_preview_op
   return 0;
 }
 
-int
-generate_boilerplate (struct lu_state_t *state, struct lu_preview_options_t *options, FILE *out)
+static int
+render_boilerplate (struct lu_state_t *state, struct lu_preview_options_t *options, struct lu_comment_style_t *style, FILE *out)
 {
   int err = 0;
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fp = fopen (tmp, "w");
+  char *data = NULL;
+  size_t data_len = 0;
+  FILE *fp = open_memstream (&data, &data_len);
   if (!fp)
-    {
-      remove (tmp);
-      return -1;
-    }
+    return -1;
 
-  char *fmt = g_find_program_in_path ("fmt");
-  if (!fmt)
-    {
-      remove (tmp);
-      return -2;
-    }
-  err = generate_uncommented_boilerplate (state, options, fmt, fp);
-  free (fmt);
+  err = generate_uncommented_boilerplate (state, options, fp);
   fclose (fp);
   if (err)
     {
-      remove (tmp);
+      free (data);
       return -3;
     }
-  struct lu_comment_style_t * style = lu_get_current_commenting_style();
   if (options->no_style || !style)
     {
-      FILE *uncommented_boilerplate = fopen (tmp, "r");
-      if (uncommented_boilerplate)
+      fprintf (out, "%s", data);
+      fprintf (out, "\n");
+    }
+  else
+    {
+      struct lu_comment_options_t comment_options;
+      memset (&comment_options, 0, sizeof (comment_options));
+      comment_options.style = style;
+      char *commented_boilerplate = 
+        lu_create_comment (state, &comment_options, data);
+      if (commented_boilerplate)
         {
-          size_t data_len = 0;
-          char *data = fread_file (uncommented_boilerplate, &data_len);
-          if (data)
-            {
-              fprintf (out, "%s", data);
-              fprintf (out, "\n");
-              free (data);
-            }
-          fclose (uncommented_boilerplate);
+          fprintf (out, "%s", commented_boilerplate);
+          free (commented_boilerplate);
         }
     }
+  free (data);
+  return err;
+}
+
+static char *inputs[] = 
+{
+  "top-line", "copyright-holders", "project-line", "license-notice", NULL
+};
+
+//the key is a checksum of every input file, the style and our version.
+//the comment delimiters go in too, so that changing a style in the
+//table in styles.c doesn't bring back the old comments.
+static char *
+get_boilerplate_cache_key (struct lu_comment_style_t *style)
+{
+  const char *style_name = style ? style->name : "none";
+  const char *open = style ? style->open : "";
+  const char *close = style && style->close ? style->close : "";
+  struct md2_ctx md2;
+  md2_init_ctx (&md2);
+  md2_process_bytes (PACKAGE_VERSION, strlen (PACKAGE_VERSION) + 1, &md2);
+  md2_process_bytes (style_name, strlen (style_name) + 1, &md2);
+  md2_process_bytes (open, strlen (open) + 1, &md2);
+  md2_process_bytes (close, strlen (close) + 1, &md2);
+  for (char **input = inputs; *input; input++)
+    {
+      md2_process_bytes (*input, strlen (*input) + 1, &md2);
+      char *f = get_config_file (*input);
+      FILE *fp = fopen (f, "r");
+      free (f);
+      if (!fp)
+        continue;
+      size_t data_len = 0;
+      char *data = fread_file (fp, &data_len);
+      fclose (fp);
+      if (data)
+        {
+          char *len = xasprintf ("%zu", data_len);
+          md2_process_bytes (len, strlen (len) + 1, &md2);
+          md2_process_bytes (data, data_len, &md2);
+          free (len);
+          free (data);
+        }
+    }
+  unsigned char buf[16];
+  md2_finish_ctx (&md2, buf);
+  char key[sizeof (buf) * 2 + 1];
+  for (int i = 0; i < sizeof (buf); i++)
+    snprintf (&key[i * 2], 3, "%02x", buf[i]);
+  return xasprintf ("%s-%s", style_name, key);
+}
+
+//get rid of the old renderings for this style.
+static void
+remove_stale_boilerplates (char *dir, const char *style_name, char *current)
+{
+  DIR *d = opendir (dir);
+  if (!d)
+    return;
+  char *prefix = xasprintf ("%s-", style_name);
+  struct dirent *entry;
+  while ((entry = readdir (d)))
+    {
+      if (entry->d_name[0] == '.')
+        continue;
+      if (strncmp (entry->d_name, prefix, strlen (prefix)) != 0)
+        continue;
+      if (strcmp (entry->d_name, current) == 0)
+        continue;
+      char *f = xasprintf ("%s/%s", dir, entry->d_name);
+      remove (f);
+      free (f);
+    }
+  free (prefix);
+  closedir (d);
+}
+
+static struct lu_comment_style_t *
+get_style (struct lu_preview_options_t *options)
+{
+  if (options->no_style)
+    return NULL;
+  return lu_get_current_commenting_style();
+}
+
+static char *
+cache_boilerplate (struct lu_state_t *state, struct lu_preview_options_t *options, struct lu_comment_style_t *style)
+{
+  const char *style_name = style ? style->name : "none";
+
+  char *dir = get_config_file ("boilerplate-cache");
+  mkdir (dir, 0775);
+  char *key = get_boilerplate_cache_key (style);
+  char *file = xasprintf ("%s/%s", dir, key);
+  if (access (file, R_OK) == 0)
+    {
+      lu_stats_add (LU_STATS_CACHE_HITS, 1);
+      free (key);
+      free (dir);
+      return file;
+    }
+  lu_stats_add (LU_STATS_CACHE_MISSES, 1);
+
+  //render it next to the cache entry, and then move it into place.
+  char *tmp = xasprintf ("%s/.%s.XXXXXX", dir, key);
+  int fd = mkstemp (tmp);
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
+  FILE *fp = NULL;
+  if (fd != -1)
+    fp = fdopen (fd, "w");
+  int err = -1;
+  if (fp)
+    {
+      err = render_boilerplate (state, options, style, fp);
+      if (fflush (fp) != 0)
+        err = -1;
+      fclose (fp);
+    }
+  else if (fd != -1)
+    close (fd);
+  if (!err && rename (tmp, file) == 0)
+    remove_stale_boilerplates (dir, style_name, key);
   else
     {
-      FILE *uncommented_boilerplate = fopen (tmp, "r");
-      if (uncommented_boilerplate)
+      remove (tmp);
+      free (file);
+      file = NULL;
+    }
+  free (tmp);
+  free (key);
+  free (dir);
+  return file;
+}
+
+//without a cache that can be written to, it gets rendered into a
+//temporary file that free_boilerplate_file takes away again.
+char *
+get_boilerplate_file (struct lu_state_t *state, struct lu_preview_options_t *options)
+{
+  struct lu_comment_style_t *style = get_style (options);
+  char *file = cache_boilerplate (state, options, style);
+  if (file)
+    return file;
+  file = xasprintf ("/tmp/%s.XXXXXX", PACKAGE);
+  int fd = mkstemp (file);
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
+  FILE *fp = NULL;
+  if (fd != -1)
+    fp = fdopen (fd, "w");
+  int err = -1;
+  if (fp)
+    {
+      err = render_boilerplate (state, options, style, fp);
+      if (fflush (fp) != 0)
+        err = -1;
+      fclose (fp);
+    }
+  else if (fd != -1)
+    close (fd);
+  if (err)
+    {
+      error (0, errno, N_("could not write `%s'"), file);
+      if (fd != -1)
+        remove (file);
+      free (file);
+      return NULL;
+    }
+  return file;
+}
+
+void
+free_boilerplate_file (char *file)
+{
+  if (!file)
+    return;
+  char *dir = get_config_file ("boilerplate-cache");
+  size_t len = strlen (dir);
+  if (strncmp (file, dir, len) != 0 || file[len] != '/')
+    remove (file);
+  free (dir);
+  free (file);
+}
+
+void
+clear_boilerplate_cache ()
+{
+  char *dir = get_config_file ("boilerplate-cache");
+  DIR *d = opendir (dir);
+  if (d)
+    {
+      struct dirent *entry;
+      while ((entry = readdir (d)))
         {
-          size_t data_len = 0;
-          char *data = fread_file (uncommented_boilerplate, &data_len);
-          if (data)
-            {
-              struct lu_comment_options_t comment_options;
-              memset (&comment_options, 0, sizeof (comment_options));
-              argz_add (&comment_options.input_files,
-                        &comment_options.input_files_len, tmp);
-              comment_options.style = style;
-              char *commented_boilerplate = 
-                lu_create_comment (state, &comment_options, data);
-              free (data);
-              if (commented_boilerplate)
-                {
-                  fprintf (out, "%s", commented_boilerplate);
-                  free (commented_boilerplate);
-                }
-            }
-          fclose (uncommented_boilerplate);
+          if (strcmp (entry->d_name, ".") == 0 ||
+              strcmp (entry->d_name, "..") == 0)
+            continue;
+          char *f = xasprintf ("%s/%s", dir, entry->d_name);
+          remove (f);
+          free (f);
         }
+      closedir (d);
+      rmdir (dir);
     }
-  remove (tmp);
+  free (dir);
+}
+
+int
+generate_boilerplate (struct lu_state_t *state, struct lu_preview_options_t *options, FILE *out)
+{
+  struct lu_comment_style_t *style = get_style (options);
+  char *file = cache_boilerplate (state, options, style);
+  //without a cache that can be written to, it gets rendered every time.
+  if (!file)
+    return render_boilerplate (state, options, style, out);
+  int err = dump_file (file, out);
+  free (file);
   return err;
 }
 
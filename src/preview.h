@@ -32,5 +32,8 @@ struct lu_preview_options_t
 int lu_preview_parse_argp (struct lu_state_t *, int argc, char **argv);
 int lu_preview (struct lu_state_t *, struct lu_preview_options_t *);
 int generate_boilerplate (struct lu_state_t *state, struct lu_preview_options_t *options, FILE *out);
+char * get_boilerplate_file (struct lu_state_t *state, struct lu_preview_options_t *options);
+void free_boilerplate_file (char *file);
+void clear_boilerplate_cache ();
 extern struct lu_command_t preview;
 #endif
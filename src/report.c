@@ -0,0 +1,445 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <argz.h>
+#include <glib.h>
+#include "licensing_priv.h"
+#include "report.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "styles.h"
+#include "batch.h"
+#include "detect.h"
+#include "archive.h"
+#include "arena.h"
+
+static struct argp_option argp_options[] =
+{
+    {"format", 'f', "FORMAT", 0, N_("show the report as text or json")},
+    {"jobs", 'j', "NUM", 0, N_("work on NUM files at a time")},
+    {0}
+};
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  struct lu_report_options_t *opt = NULL;
+  if (state)
+    opt = (struct lu_report_options_t*) state->input;
+  switch (key)
+    {
+    case 'f':
+      if (strcmp (arg, "text") == 0)
+        opt->format = LU_REPORT_TEXT;
+      else if (strcmp (arg, "json") == 0)
+        opt->format = LU_REPORT_JSON;
+      else
+        {
+          argp_failure (state, 0, 0, N_("`%s' is not text or json"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    case 'j':
+      opt->jobs = lu_batch_parse_jobs (arg);
+      if (opt->jobs == -1)
+        {
+          argp_failure (state, 0, 0,
+                        N_("`%s' is an invalid number of jobs"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    case ARGP_KEY_ARG:
+      argz_add (&opt->input_files, &opt->input_files_len, arg);
+      break;
+    case ARGP_KEY_INIT:
+      opt->input_files = NULL;
+      opt->input_files_len = 0;
+      opt->format = LU_REPORT_TEXT;
+      opt->jobs = lu_batch_default_jobs ();
+      opt->style = NULL;
+      state->child_inputs[0] = &opt->style;
+      break;
+    case ARGP_KEY_FINI:
+      if (opt->input_files == NULL)
+        {
+          argp_failure (state, 0, 0, N_("no files specified"));
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
+static struct argp_child parsers[]=
+{
+    { &styles_argp, 0, N_("Commenting Style Options:"), 0 },
+    { 0 }
+};
+
+#undef REPORT_DOC
+#define REPORT_DOC \
+  N_("Count the licenses and commenting styles of the files in a tree.") "\v"\
+  N_("The comments at the top of each FILE are compared with the license notices, and the number of files with each license and in each commenting style are shown.") "  "\
+  N_("Files that are not much like any of the licenses are counted as `unknown'.") "  "\
+  N_("Directories are looked in recursively.") "  "\
+  N_("Comment style is auto-detected if a style option is not provided.")
+static struct argp argp = { argp_options, parse_opt, "FILE...", REPORT_DOC,
+  parsers};
+
+int
+lu_report_parse_argp (struct lu_state_t *state, int argc, char **argv)
+{
+  int err = 0;
+  struct lu_report_options_t opts;
+  opts.state = state;
+
+  err = argp_parse (&argp, argc, argv, state->argp_flags,  0, &opts);
+  if (!err)
+    return lu_report (state, &opts);
+  else
+    return err;
+}
+
+struct report_t;
+
+//what one thread has counted.  nothing in here is shared, so the
+//threads don't have to wait on each other until they're merged.
+struct tally_t
+{
+  struct report_t *report;
+  GHashTable *licenses;
+  GHashTable *styles;
+  //the license of each uncommented header that has been seen, because
+  //most of the files in a tree have the same one.
+  GHashTable *seen;
+  int files;
+  int no_boilerplate;
+};
+
+struct report_t
+{
+  struct lu_state_t *state;
+  struct lu_report_options_t *options;
+  char **files;
+  int num_files;
+  gint next_file;
+  GOnce notices;
+  struct tally_t *tallies;
+};
+
+static void
+init_tally (struct tally_t *tally, struct report_t *report)
+{
+  tally->report = report;
+  tally->licenses = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+                                           NULL);
+  tally->styles = g_hash_table_new_full (g_str_hash, g_str_equal, free, NULL);
+  tally->seen = g_hash_table_new_full (g_str_hash, g_str_equal, free, free);
+  tally->files = 0;
+  tally->no_boilerplate = 0;
+}
+
+static void
+free_tally (struct tally_t *tally)
+{
+  g_hash_table_destroy (tally->licenses);
+  g_hash_table_destroy (tally->styles);
+  g_hash_table_destroy (tally->seen);
+}
+
+static void
+count (GHashTable *counts, const char *name, int n)
+{
+  int sum = GPOINTER_TO_INT (g_hash_table_lookup (counts, name)) + n;
+  g_hash_table_replace (counts, strdup (name), GINT_TO_POINTER (sum));
+}
+
+static gpointer
+make_notices (gpointer data)
+{
+  struct report_t *report = data;
+  return lu_license_notices_new (report->state);
+}
+
+//the license notices are only made when the first header turns up, so
+//a tree without any boilerplate doesn't need them.  after that, getting
+//them doesn't take a lock.
+static struct lu_license_notices_t *
+get_notices (struct report_t *report)
+{
+  return g_once (&report->notices, make_notices, report);
+}
+
+static char *
+match_license (void *data, char *text)
+{
+  struct tally_t *tally = data;
+  gpointer license = NULL;
+  if (!g_hash_table_lookup_extended (tally->seen, text, NULL, &license))
+    {
+      license = lu_license_notices_match (get_notices (tally->report), text);
+      g_hash_table_insert (tally->seen, strdup (text),
+                           license ? strdup (license) : NULL);
+      return license;
+    }
+  return license ? strdup (license) : NULL;
+}
+
+static void
+count_license (struct tally_t *tally, int has_comments, struct lu_comment_style_t *found, char *license)
+{
+  tally->files++;
+  if (!has_comments)
+    tally->no_boilerplate++;
+  else
+    {
+      count (tally->licenses, license ? license : "unknown", 1);
+      count (tally->styles, found->name, 1);
+    }
+  free (license);
+}
+
+//the files in archives are counted like any other file.
+static int
+report_member (void *data, char *name, FILE *fp)
+{
+  struct tally_t *tally = data;
+  struct report_t *report = tally->report;
+  struct lu_comment_style_t *found = NULL;
+  char *license = NULL;
+  int has_comments =
+    lu_detect_license_of_stream (report->state, name, fp,
+                                 report->options->style, match_license,
+                                 tally, &found, &license);
+  count_license (tally, has_comments, found, license);
+  lu_arena_reset (lu_arena_get ());
+  return 0;
+}
+
+static gpointer
+report_worker (gpointer data)
+{
+  struct tally_t *tally = data;
+  struct report_t *report = tally->report;
+  int i;
+  while ((i = g_atomic_int_add (&report->next_file, 1)) < report->num_files)
+    {
+      char *file = report->files[i];
+      if (lu_is_an_archive (file))
+        {
+          lu_archive_foreach (file, report_member, tally);
+          continue;
+        }
+      struct lu_comment_style_t *found = NULL;
+      char *license = NULL;
+      int has_comments =
+        lu_detect_license_of_file (report->state, file,
+                                   report->options->style, match_license,
+                                   tally, &found, &license);
+      count_license (tally, has_comments, found, license);
+      //the comments of each file are worked out in the thread's arena.
+      lu_arena_reset (lu_arena_get ());
+    }
+  return NULL;
+}
+
+static void
+merge_tally (struct tally_t *total, struct tally_t *tally)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init (&iter, tally->licenses);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    count (total->licenses, key, GPOINTER_TO_INT (value));
+  g_hash_table_iter_init (&iter, tally->styles);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    count (total->styles, key, GPOINTER_TO_INT (value));
+  total->files += tally->files;
+  total->no_boilerplate += tally->no_boilerplate;
+}
+
+struct report_count_t
+{
+  char *name;
+  int count;
+};
+
+static int
+compare_counts (const void *lhs, const void *rhs)
+{
+  const struct report_count_t *l = lhs;
+  const struct report_count_t *r = rhs;
+  if (l->count != r->count)
+    return r->count - l->count;
+  return strcmp (l->name, r->name);
+}
+
+//the most common ones come first.
+static struct report_count_t *
+sort_counts (GHashTable *counts, int *num)
+{
+  *num = g_hash_table_size (counts);
+  struct report_count_t *sorted =
+    calloc (*num + 1, sizeof (struct report_count_t));
+  GHashTableIter iter;
+  gpointer key, value;
+  int i = 0;
+  g_hash_table_iter_init (&iter, counts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      sorted[i].name = key;
+      sorted[i].count = GPOINTER_TO_INT (value);
+      i++;
+    }
+  qsort (sorted, *num, sizeof (struct report_count_t), compare_counts);
+  return sorted;
+}
+
+//names go in json strings, so the quotes and backslashes in them get
+//escaped.
+static void
+show_json_string (struct lu_state_t *state, const char *name)
+{
+  luprintf (state, "\"");
+  for (const char *p = name; *p; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        luprintf (state, "\\%c", *p);
+      else if ((unsigned char) *p < 0x20)
+        luprintf (state, "\\u%04x", (unsigned char) *p);
+      else
+        luprintf (state, "%c", *p);
+    }
+  luprintf (state, "\"");
+}
+
+static void
+show_counts (struct lu_state_t *state, enum lu_report_format_t format, const char *title, GHashTable *counts)
+{
+  int num = 0;
+  struct report_count_t *sorted = sort_counts (counts, &num);
+  if (format == LU_REPORT_JSON)
+    {
+      luprintf (state, ", \"%s\": {", title);
+      for (int i = 0; i < num; i++)
+        {
+          if (i)
+            luprintf (state, ", ");
+          show_json_string (state, sorted[i].name);
+          luprintf (state, ": %d", sorted[i].count);
+        }
+      luprintf (state, "}");
+    }
+  else if (num)
+    {
+      luprintf (state, "%s:\n", title);
+      for (int i = 0; i < num; i++)
+        luprintf (state, "  %-16s %8d\n", sorted[i].name, sorted[i].count);
+    }
+  free (sorted);
+}
+
+static void
+show_report (struct lu_state_t *state, enum lu_report_format_t format, struct tally_t *total)
+{
+  if (format == LU_REPORT_JSON)
+    {
+      luprintf (state, "{\"files\": %d, \"no_boilerplate\": %d",
+                total->files, total->no_boilerplate);
+      show_counts (state, format, "licenses", total->licenses);
+      show_counts (state, format, "styles", total->styles);
+      luprintf (state, "}\n");
+    }
+  else
+    {
+      show_counts (state, format, N_("Licenses"), total->licenses);
+      show_counts (state, format, N_("Styles"), total->styles);
+      luprintf (state, N_("%d files, %d without boilerplate\n"),
+                total->files, total->no_boilerplate);
+    }
+}
+
+int
+lu_report (struct lu_state_t *state, struct lu_report_options_t *options)
+{
+  int err = 0;
+  char *files = NULL;
+  size_t files_len = 0;
+  char *f = NULL;
+  while ((f = argz_next (options->input_files, options->input_files_len, f)))
+    if (lu_collect_files (f, 1, &files, &files_len))
+      err = 1;
+
+  struct report_t report;
+  report.state = state;
+  report.options = options;
+  report.num_files = argz_count (files, files_len);
+  report.files = calloc (report.num_files + 1, sizeof (char *));
+  argz_extract (files, files_len, report.files);
+  report.next_file = 0;
+  report.notices = (GOnce) G_ONCE_INIT;
+
+  //each thread counts what it finds on its own, and the counts are
+  //added up once they're all done.
+  int jobs = options->jobs;
+  if (jobs > report.num_files)
+    jobs = report.num_files;
+  if (jobs < 1)
+    jobs = 1;
+  report.tallies = calloc (jobs, sizeof (struct tally_t));
+  GThread **threads = calloc (jobs, sizeof (GThread *));
+  for (int i = 0; i < jobs; i++)
+    {
+      init_tally (&report.tallies[i], &report);
+      threads[i] = g_thread_new ("report", report_worker, &report.tallies[i]);
+    }
+  struct tally_t total;
+  init_tally (&total, &report);
+  for (int i = 0; i < jobs; i++)
+    {
+      g_thread_join (threads[i]);
+      merge_tally (&total, &report.tallies[i]);
+      free_tally (&report.tallies[i]);
+    }
+  free (threads);
+  free (report.tallies);
+
+  show_report (state, options->format, &total);
+
+  free_tally (&total);
+  if (report.notices.retval)
+    lu_license_notices_free (report.notices.retval);
+  free (report.files);
+  free (files);
+  free (options->input_files);
+  return err;
+}
+
+struct lu_command_t report =
+{
+  .name         = N_("report"),
+  .doc          = REPORT_DOC,
+  .flags        = SHOW_IN_HELP | SAVE_IN_HISTORY,
+  .argp         = &argp,
+  .parser       = lu_report_parse_argp
+};
@@ -0,0 +1,268 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "licensing_priv.h"
+#include "result-cache.h"
+#include "xvasprintf.h"
+#include "read-file.h"
+#include "md2.h"
+#include "stats.h"
+
+//the results in memory stop growing when their keys and results take
+//up this much.
+#define MAX_MEMORY (64 * 1024 * 1024)
+
+struct result_t
+{
+  //the kind, a nul, and then the key.
+  char *key;
+  size_t key_len;
+  char *result;
+  size_t result_len;
+};
+
+static GMutex lock;
+static GHashTable *results;
+static size_t memory_used;
+static int persist;
+
+static guint
+hash_result (gconstpointer r)
+{
+  const struct result_t *result = r;
+  guint hash = 5381;
+  for (size_t i = 0; i < result->key_len; i++)
+    hash = hash * 33 + (unsigned char) result->key[i];
+  return hash;
+}
+
+static gboolean
+equal_results (gconstpointer lhs, gconstpointer rhs)
+{
+  const struct result_t *l = lhs;
+  const struct result_t *r = rhs;
+  return l->key_len == r->key_len && memcmp (l->key, r->key, l->key_len) == 0;
+}
+
+static void
+free_result (gpointer r)
+{
+  struct result_t *result = r;
+  free (result->key);
+  free (result->result);
+  free (result);
+}
+
+void
+lu_result_cache_init (int persist_results)
+{
+  persist = persist_results;
+  if (!results)
+    results = g_hash_table_new_full (hash_result, equal_results, free_result,
+                                     NULL);
+}
+
+static char *
+make_key (const char *kind, const char *key, size_t key_len, size_t *len)
+{
+  size_t kind_len = strlen (kind) + 1;
+  char *k = malloc (kind_len + key_len);
+  memcpy (k, kind, kind_len);
+  memcpy (&k[kind_len], key, key_len);
+  *len = kind_len + key_len;
+  return k;
+}
+
+static char *
+copy_result (const char *result, size_t result_len)
+{
+  if (!result)
+    return NULL;
+  char *copy = malloc (result_len + 1);
+  memcpy (copy, result, result_len);
+  copy[result_len] = '\0';
+  return copy;
+}
+
+//keep KEY and a copy of RESULT in memory, if there's room.  KEY is ours
+//to free either way.
+static void
+remember (char *key, size_t key_len, const char *result, size_t result_len)
+{
+  struct result_t *r = malloc (sizeof (struct result_t));
+  r->key = key;
+  r->key_len = key_len;
+  r->result = copy_result (result, result_len);
+  r->result_len = result_len;
+  g_mutex_lock (&lock);
+  if (results && memory_used + key_len + result_len < MAX_MEMORY &&
+      !g_hash_table_contains (results, r))
+    {
+      g_hash_table_insert (results, r, r);
+      memory_used += key_len + result_len;
+      r = NULL;
+    }
+  g_mutex_unlock (&lock);
+  if (r)
+    free_result (r);
+}
+
+//where a result is kept on disk: a checksum of the key and our version.
+static char *
+get_result_file (const char *kind, const char *key, size_t key_len)
+{
+  struct md2_ctx md2;
+  md2_init_ctx (&md2);
+  md2_process_bytes (PACKAGE_VERSION, strlen (PACKAGE_VERSION) + 1, &md2);
+  md2_process_bytes (key, key_len, &md2);
+  unsigned char buf[16];
+  md2_finish_ctx (&md2, buf);
+  char sum[sizeof (buf) * 2 + 1];
+  for (int i = 0; i < sizeof (buf); i++)
+    snprintf (&sum[i * 2], 3, "%02x", buf[i]);
+  char *dir = get_config_file ("result-cache");
+  char *file = xasprintf ("%s/%s-%s", dir, kind, sum);
+  free (dir);
+  return file;
+}
+
+//the file has a + and then the result, or a - when there isn't one.
+static int
+read_result_file (char *file, char **result, size_t *result_len)
+{
+  FILE *fp = fopen (file, "r");
+  if (!fp)
+    return 0;
+  size_t len = 0;
+  char *data = fread_file (fp, &len);
+  fclose (fp);
+  if (!data || len == 0 || (data[0] != '+' && data[0] != '-'))
+    {
+      free (data);
+      return 0;
+    }
+  *result = data[0] == '+' ? copy_result (&data[1], len - 1) : NULL;
+  *result_len = data[0] == '+' ? len - 1 : 0;
+  free (data);
+  return 1;
+}
+
+static void
+write_result_file (char *file, const char *result, size_t result_len)
+{
+  char *dir = get_config_file ("result-cache");
+  mkdir (dir, 0775);
+  free (dir);
+  char *tmp = xasprintf ("%s.XXXXXX", file);
+  int fd = mkstemp (tmp);
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
+  FILE *fp = NULL;
+  if (fd != -1)
+    fp = fdopen (fd, "w");
+  int err = -1;
+  if (fp)
+    {
+      fputc (result ? '+' : '-', fp);
+      if (result)
+        fwrite (result, 1, result_len, fp);
+      err = ferror (fp);
+      if (fclose (fp) != 0)
+        err = -1;
+    }
+  else if (fd != -1)
+    close (fd);
+  if (err || rename (tmp, file) != 0)
+    remove (tmp);
+  free (tmp);
+}
+
+int
+lu_result_cache_lookup (const char *kind, const char *key, size_t key_len, char **result, size_t *result_len)
+{
+  struct result_t probe;
+  probe.key = make_key (kind, key, key_len, &probe.key_len);
+  int found = 0;
+  g_mutex_lock (&lock);
+  struct result_t *r = NULL;
+  if (results)
+    r = g_hash_table_lookup (results, &probe);
+  if (r)
+    {
+      *result = copy_result (r->result, r->result_len);
+      *result_len = r->result_len;
+      found = 1;
+    }
+  g_mutex_unlock (&lock);
+  if (!found && persist)
+    {
+      char *file = get_result_file (kind, probe.key, probe.key_len);
+      found = read_result_file (file, result, result_len);
+      free (file);
+      if (found)
+        {
+          remember (probe.key, probe.key_len, *result, *result_len);
+          probe.key = NULL;
+        }
+    }
+  free (probe.key);
+  lu_stats_add (found ? LU_STATS_RESULT_HITS : LU_STATS_RESULT_MISSES, 1);
+  return found;
+}
+
+void
+lu_result_cache_store (const char *kind, const char *key, size_t key_len, const char *result, size_t result_len)
+{
+  size_t len = 0;
+  char *k = make_key (kind, key, key_len, &len);
+  if (persist)
+    {
+      char *file = get_result_file (kind, k, len);
+      write_result_file (file, result, result_len);
+      free (file);
+    }
+  remember (k, len, result, result_len);
+}
+
+void
+clear_result_cache ()
+{
+  char *dir = get_config_file ("result-cache");
+  DIR *d = opendir (dir);
+  if (d)
+    {
+      struct dirent *entry;
+      while ((entry = readdir (d)))
+        {
+          if (strcmp (entry->d_name, ".") == 0 ||
+              strcmp (entry->d_name, "..") == 0)
+            continue;
+          char *f = xasprintf ("%s/%s", dir, entry->d_name);
+          remove (f);
+          free (f);
+        }
+      closedir (d);
+      rmdir (dir);
+    }
+  free (dir);
+}
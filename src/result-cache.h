@@ -0,0 +1,37 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_RESULT_CACHE_H
+#define LU_RESULT_CACHE_H 1
+
+#include <config.h>
+#include <stddef.h>
+
+//results that are worked out from nothing but the header of a file, so
+//that the files in a tree that share a header are only worked on once.
+//KIND says what the result is, and KEY is the header along with
+//anything else the result depends on.  a NULL result is kept too.
+//the results are kept in memory for the run, and also in
+//~/.licenseutils/result-cache when PERSIST is set.
+void lu_result_cache_init (int persist);
+
+//1 when KEY has a result, which is put in RESULT and RESULT_LEN.
+int lu_result_cache_lookup (const char *kind, const char *key, size_t key_len, char **result, size_t *result_len);
+void lu_result_cache_store (const char *kind, const char *key, size_t key_len, const char *result, size_t result_len);
+
+void clear_result_cache ();
+#endif
@@ -0,0 +1,305 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "licensing_priv.h"
+#include "scan-cache.h"
+#include "xvasprintf.h"
+#include "read-file.h"
+#include "stat-time.h"
+#include "md2.h"
+#include "stats.h"
+
+//the first line of the cache file.  a cache from another version is
+//thrown away, because the styles and licenses might have changed.
+#define SCAN_CACHE_HEADER PACKAGE " scan cache " PACKAGE_VERSION "\n"
+
+struct scan_t
+{
+  unsigned long long dev;
+  unsigned long long ino;
+  long long size;
+  long long mtime_sec;
+  long mtime_nsec;
+  char *result;
+  size_t result_len;
+  int seen;
+};
+
+static GMutex lock;
+//the keys are the kind, a space and then the absolute path of the file.
+static GHashTable *scans;
+static char *cache_file;
+static char *current_dir;
+static int changed;
+
+static void
+free_scan (gpointer s)
+{
+  struct scan_t *scan = s;
+  free (scan->result);
+  free (scan);
+}
+
+static char *
+copy_result (const char *result, size_t result_len)
+{
+  if (!result)
+    return NULL;
+  char *copy = malloc (result_len + 1);
+  memcpy (copy, result, result_len);
+  copy[result_len] = '\0';
+  return copy;
+}
+
+//the file that the cache of the current directory goes in.
+static char *
+get_tree_cache_file ()
+{
+  struct md2_ctx md2;
+  md2_init_ctx (&md2);
+  md2_process_bytes (current_dir, strlen (current_dir), &md2);
+  unsigned char buf[16];
+  md2_finish_ctx (&md2, buf);
+  char sum[sizeof (buf) * 2 + 1];
+  for (int i = 0; i < sizeof (buf); i++)
+    snprintf (&sum[i * 2], 3, "%02x", buf[i]);
+  char *dir = get_config_file ("scan-cache");
+  char *file = xasprintf ("%s/%s", dir, sum);
+  free (dir);
+  return file;
+}
+
+//each scan is a line of numbers, followed by the key and the result.
+//the result length is -1 when there isn't a result.
+static void
+load_scans (char *data, size_t len)
+{
+  size_t header_len = strlen (SCAN_CACHE_HEADER);
+  if (len < header_len || memcmp (data, SCAN_CACHE_HEADER, header_len) != 0)
+    return;
+  char *end = &data[len];
+  char *p = &data[header_len];
+  while (p < end && memchr (p, '\n', end - p))
+    {
+      struct scan_t scan;
+      long long key_len, result_len;
+      memset (&scan, 0, sizeof (scan));
+      if (sscanf (p, "%llu %llu %lld %lld %ld %lld %lld\n", &scan.dev,
+                  &scan.ino, &scan.size, &scan.mtime_sec, &scan.mtime_nsec,
+                  &key_len, &result_len) != 7)
+        break;
+      p = memchr (p, '\n', end - p) + 1;
+      if (key_len <= 0 || result_len < -1 ||
+          key_len + (result_len > 0 ? result_len : 0) + 1 > end - p)
+        break;
+      struct scan_t *s = malloc (sizeof (struct scan_t));
+      *s = scan;
+      char *key = strndup (p, key_len);
+      p += key_len;
+      if (result_len >= 0)
+        {
+          s->result = copy_result (p, result_len);
+          s->result_len = result_len;
+          p += result_len;
+        }
+      p++;
+      g_hash_table_replace (scans, key, s);
+    }
+}
+
+void
+lu_scan_cache_init (const char *file)
+{
+  if (!file || scans)
+    return;
+  scans = g_hash_table_new_full (g_str_hash, g_str_equal, free, free_scan);
+  char *cwd = g_get_current_dir ();
+  current_dir = strdup (cwd);
+  g_free (cwd);
+  if (file[0] == '\0')
+    {
+      char *dir = get_config_file ("scan-cache");
+      mkdir (dir, 0775);
+      free (dir);
+      cache_file = get_tree_cache_file ();
+    }
+  else
+    cache_file = strdup (file);
+  FILE *fp = fopen (cache_file, "r");
+  if (fp)
+    {
+      size_t len = 0;
+      char *data = fread_file (fp, &len);
+      fclose (fp);
+      if (data)
+        load_scans (data, len);
+      free (data);
+    }
+}
+
+static char *
+make_key (const char *kind, const char *file)
+{
+  if (file[0] == '/')
+    return xasprintf ("%s %s", kind, file);
+  return xasprintf ("%s %s/%s", kind, current_dir, file);
+}
+
+static int
+same_file (struct scan_t *scan, const struct stat *st)
+{
+  struct timespec mtime = get_stat_mtime (st);
+  return scan->dev == st->st_dev && scan->ino == st->st_ino &&
+    scan->size == st->st_size && scan->mtime_sec == mtime.tv_sec &&
+    scan->mtime_nsec == mtime.tv_nsec;
+}
+
+int
+lu_scan_cache_lookup (const char *kind, const char *file, const struct stat *st, char **result, size_t *result_len)
+{
+  if (!scans || !S_ISREG (st->st_mode))
+    return 0;
+  char *key = make_key (kind, file);
+  int found = 0;
+  g_mutex_lock (&lock);
+  struct scan_t *scan = g_hash_table_lookup (scans, key);
+  if (scan)
+    {
+      scan->seen = 1;
+      if (same_file (scan, st))
+        {
+          *result = copy_result (scan->result, scan->result_len);
+          *result_len = scan->result_len;
+          found = 1;
+        }
+    }
+  g_mutex_unlock (&lock);
+  free (key);
+  lu_stats_add (found ? LU_STATS_SCAN_HITS : LU_STATS_SCAN_MISSES, 1);
+  return found;
+}
+
+void
+lu_scan_cache_store (const char *kind, const char *file, const struct stat *st, const char *result, size_t result_len)
+{
+  if (!scans || !S_ISREG (st->st_mode))
+    return;
+  struct timespec mtime = get_stat_mtime (st);
+  struct scan_t *scan = malloc (sizeof (struct scan_t));
+  scan->dev = st->st_dev;
+  scan->ino = st->st_ino;
+  scan->size = st->st_size;
+  scan->mtime_sec = mtime.tv_sec;
+  scan->mtime_nsec = mtime.tv_nsec;
+  scan->result = copy_result (result, result_len);
+  scan->result_len = result_len;
+  scan->seen = 1;
+  g_mutex_lock (&lock);
+  g_hash_table_replace (scans, make_key (kind, file), scan);
+  changed = 1;
+  g_mutex_unlock (&lock);
+}
+
+//the files that weren't looked at on this run are kept, unless they
+//have gone away.
+static int
+scan_is_stale (const char *key, struct scan_t *scan)
+{
+  if (scan->seen)
+    return 0;
+  struct stat st;
+  return stat (strchr (key, ' ') + 1, &st) != 0;
+}
+
+static void
+write_scans (FILE *fp)
+{
+  fputs (SCAN_CACHE_HEADER, fp);
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init (&iter, scans);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      struct scan_t *scan = value;
+      if (scan_is_stale (key, scan))
+        continue;
+      fprintf (fp, "%llu %llu %lld %lld %ld %zu %lld\n", scan->dev, scan->ino,
+               scan->size, scan->mtime_sec, scan->mtime_nsec, strlen (key),
+               scan->result ? (long long) scan->result_len : -1LL);
+      fputs (key, fp);
+      if (scan->result)
+        fwrite (scan->result, 1, scan->result_len, fp);
+      fputc ('\n', fp);
+    }
+}
+
+void
+lu_scan_cache_save ()
+{
+  if (!scans || !changed)
+    return;
+  char *tmp = xasprintf ("%s.XXXXXX", cache_file);
+  int fd = mkstemp (tmp);
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
+  FILE *fp = NULL;
+  if (fd != -1)
+    fp = fdopen (fd, "w");
+  int err = -1;
+  if (fp)
+    {
+      write_scans (fp);
+      err = ferror (fp);
+      if (fclose (fp) != 0)
+        err = -1;
+    }
+  else if (fd != -1)
+    close (fd);
+  if (err || rename (tmp, cache_file) != 0)
+    remove (tmp);
+  free (tmp);
+  changed = 0;
+}
+
+void
+clear_scan_cache ()
+{
+  char *dir = get_config_file ("scan-cache");
+  DIR *d = opendir (dir);
+  if (d)
+    {
+      struct dirent *entry;
+      while ((entry = readdir (d)))
+        {
+          if (strcmp (entry->d_name, ".") == 0 ||
+              strcmp (entry->d_name, "..") == 0)
+            continue;
+          char *f = xasprintf ("%s/%s", dir, entry->d_name);
+          remove (f);
+          free (f);
+        }
+      closedir (d);
+      rmdir (dir);
+    }
+  free (dir);
+}
@@ -0,0 +1,44 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_SCAN_CACHE_H
+#define LU_SCAN_CACHE_H 1
+
+#include <config.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+//what was found in each file of a tree on the last run, so that files
+//that haven't changed aren't read again.  a file hasn't changed when its
+//device, inode, size and modification time are the same.  KIND says
+//what was found, and RESULT can be NULL.
+//the scan cache is only used when FILE is given.  the cache is kept in
+//FILE, or when FILE is the empty string, in
+//~/.licenseutils/scan-cache for the current directory.
+void lu_scan_cache_init (const char *file);
+
+//1 when FILE looked like ST when RESULT was kept for it.
+int lu_scan_cache_lookup (const char *kind, const char *file, const struct stat *st, char **result, size_t *result_len);
+
+//keep RESULT for FILE, which looked like ST before it was read.
+void lu_scan_cache_store (const char *kind, const char *file, const struct stat *st, const char *result, size_t result_len);
+
+//write the cache out, if anything was kept.
+void lu_scan_cache_save ();
+
+void clear_scan_cache ();
+#endif
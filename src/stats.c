@@ -0,0 +1,125 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdio.h>
+#include <glib.h>
+#include "stats.h"
+
+static enum lu_stats_format_t stats_format = LU_STATS_OFF;
+static gint64 stats_began;
+//the workers of --jobs all add to these, so they're added to atomically
+//rather than under a lock.
+static gssize counters[LU_STATS_NUM_COUNTERS];
+static gssize timer_calls[LU_STATS_NUM_TIMERS];
+static gssize timer_usecs[LU_STATS_NUM_TIMERS];
+
+static const char *counter_names[LU_STATS_NUM_COUNTERS] =
+{
+  [LU_STATS_FILES_READ]     = "files_read",
+  [LU_STATS_BYTES_READ]     = "bytes_read",
+  [LU_STATS_FILES_WRITTEN]  = "files_written",
+  [LU_STATS_BYTES_WRITTEN]  = "bytes_written",
+  [LU_STATS_REGEX_MATCHES]  = "regex_matches",
+  [LU_STATS_CACHE_HITS]     = "cache_hits",
+  [LU_STATS_CACHE_MISSES]   = "cache_misses",
+  [LU_STATS_RESULT_HITS]    = "result_hits",
+  [LU_STATS_RESULT_MISSES]  = "result_misses",
+  [LU_STATS_SCAN_HITS]      = "scan_hits",
+  [LU_STATS_SCAN_MISSES]    = "scan_misses",
+  [LU_STATS_DOWNLOADS]      = "downloads",
+  [LU_STATS_SPAWNS]         = "spawns",
+  [LU_STATS_FSYNCS]         = "fsyncs",
+  [LU_STATS_TEMP_FILES]     = "temp_files",
+};
+
+static const char *timer_names[LU_STATS_NUM_TIMERS] =
+{
+  [LU_STATS_READ_TIME]      = "read",
+  [LU_STATS_WRITE_TIME]     = "write",
+  [LU_STATS_REGEX_TIME]     = "regex",
+  [LU_STATS_DOWNLOAD_TIME]  = "download",
+  [LU_STATS_FORMAT_TIME]    = "format",
+  [LU_STATS_SPAWN_TIME]     = "spawn",
+};
+
+void
+lu_stats_enable (enum lu_stats_format_t format)
+{
+  stats_format = format;
+  stats_began = g_get_monotonic_time ();
+}
+
+void
+lu_stats_add (enum lu_stats_counter_t counter, gint64 n)
+{
+  if (stats_format == LU_STATS_OFF)
+    return;
+  g_atomic_pointer_add (&counters[counter], n);
+}
+
+gint64
+lu_stats_start ()
+{
+  if (stats_format == LU_STATS_OFF)
+    return 0;
+  return g_get_monotonic_time ();
+}
+
+void
+lu_stats_stop (enum lu_stats_timer_t timer, gint64 start)
+{
+  if (stats_format == LU_STATS_OFF)
+    return;
+  gint64 elapsed = g_get_monotonic_time () - start;
+  g_atomic_pointer_add (&timer_calls[timer], 1);
+  g_atomic_pointer_add (&timer_usecs[timer], elapsed);
+}
+
+//the timers add up the time spent in every thread, so with --jobs they
+//can come to more than the elapsed time.
+void
+lu_stats_show (FILE *fp)
+{
+  if (stats_format == LU_STATS_OFF)
+    return;
+  double elapsed = (g_get_monotonic_time () - stats_began) / 1e6;
+  if (stats_format == LU_STATS_JSON)
+    {
+      fprintf (fp, "{\"elapsed\": %.6f, \"counters\": {", elapsed);
+      for (int i = 0; i < LU_STATS_NUM_COUNTERS; i++)
+        fprintf (fp, "%s\"%s\": %" G_GINT64_FORMAT, i ? ", " : "",
+                 counter_names[i], (gint64) counters[i]);
+      fprintf (fp, "}, \"timers\": {");
+      for (int i = 0; i < LU_STATS_NUM_TIMERS; i++)
+        fprintf (fp, "%s\"%s\": {\"calls\": %" G_GINT64_FORMAT
+                 ", \"seconds\": %.6f}", i ? ", " : "", timer_names[i],
+                 (gint64) timer_calls[i], timer_usecs[i] / 1e6);
+      fprintf (fp, "}}\n");
+    }
+  else
+    {
+      fprintf (fp, "%-16s %12.6fs\n", "elapsed", elapsed);
+      for (int i = 0; i < LU_STATS_NUM_COUNTERS; i++)
+        fprintf (fp, "%-16s %12" G_GINT64_FORMAT "\n", counter_names[i],
+                 (gint64) counters[i]);
+      for (int i = 0; i < LU_STATS_NUM_TIMERS; i++)
+        fprintf (fp, "%-16s %12.6fs %8" G_GINT64_FORMAT " calls\n",
+                 timer_names[i], timer_usecs[i] / 1e6,
+                 (gint64) timer_calls[i]);
+    }
+}
@@ -0,0 +1,76 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_STATS_H
+#define LU_STATS_H 1
+
+#include <config.h>
+#include <stdio.h>
+#include <glib.h>
+
+//the counters and timers that --stats shows when the program exits.
+//they cost nothing but a test when --stats isn't given.
+
+enum lu_stats_counter_t
+{
+  LU_STATS_FILES_READ,
+  LU_STATS_BYTES_READ,
+  LU_STATS_FILES_WRITTEN,
+  LU_STATS_BYTES_WRITTEN,
+  LU_STATS_REGEX_MATCHES,
+  LU_STATS_CACHE_HITS,
+  LU_STATS_CACHE_MISSES,
+  LU_STATS_RESULT_HITS,
+  LU_STATS_RESULT_MISSES,
+  LU_STATS_SCAN_HITS,
+  LU_STATS_SCAN_MISSES,
+  LU_STATS_DOWNLOADS,
+  LU_STATS_SPAWNS,
+  LU_STATS_FSYNCS,
+  LU_STATS_TEMP_FILES,
+  LU_STATS_NUM_COUNTERS
+};
+
+enum lu_stats_timer_t
+{
+  LU_STATS_READ_TIME,
+  LU_STATS_WRITE_TIME,
+  LU_STATS_REGEX_TIME,
+  LU_STATS_DOWNLOAD_TIME,
+  LU_STATS_FORMAT_TIME,
+  LU_STATS_SPAWN_TIME,
+  LU_STATS_NUM_TIMERS
+};
+
+enum lu_stats_format_t
+{
+  LU_STATS_OFF = 0,
+  LU_STATS_TEXT,
+  LU_STATS_JSON,
+};
+
+void lu_stats_enable (enum lu_stats_format_t format);
+void lu_stats_add (enum lu_stats_counter_t counter, gint64 n);
+
+//time a phase: keep what lu_stats_start returns, and give it back to
+//lu_stats_stop when the phase is over.
+gint64 lu_stats_start ();
+void lu_stats_stop (enum lu_stats_timer_t timer, gint64 start);
+
+//show the summary, if --stats was given.
+void lu_stats_show (FILE *fp);
+#endif
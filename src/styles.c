@@ -19,167 +19,344 @@
 #include <argz.h>
 #include <argp.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
 #include "styles.h"
 #include "gettext-more.h"
 #include "licensing_priv.h"
 #include "c-ctype.h"
 #include "read-file.h"
+#include "xvasprintf.h"
+#include "util.h"
+#include "stats.h"
+#include "classify.h"
+#include "scan-cache.h"
 
-#ifdef SUPPORT_C_STYLE
-#include "c-style.h"
-#endif
-#ifdef SUPPORT_CPLUSPLUS_STYLE
-#include "c++-style.h"
-#endif
-#ifdef SUPPORT_FORTRAN_STYLE
-#include "fortran-style.h"
-#endif
-#ifdef SUPPORT_GETTEXT_STYLE
-#include "gettext-style.h"
-#endif
-#ifdef SUPPORT_GROFF_STYLE
-#include "groff-style.h"
-#endif
-#ifdef SUPPORT_HASKELL_STYLE
-#include "haskell-style.h"
-#endif
-#ifdef SUPPORT_JAVASCRIPT_STYLE
-#include "javascript-style.h"
-#endif
-#ifdef SUPPORT_M4_STYLE
-#include "m4-style.h"
-#endif
-#ifdef SUPPORT_PASCAL_STYLE
-#include "pascal-style.h"
-#endif
-#ifdef SUPPORT_SCHEME_STYLE
-#include "scheme-style.h"
-#endif
-#ifdef SUPPORT_SHELL_STYLE
-#include "shell-style.h"
-#endif
-#ifdef SUPPORT_TEXINFO_STYLE
-#include "texinfo-style.h"
+//configure's --enable-commenting-styles can leave some of them out.
+#ifndef COMMENTING_STYLES
+#define COMMENTING_STYLES "all"
 #endif
 
-struct lu_comment_style_t* lu_styles[]=
+enum
 {
-  /* okay folks, listen up. 
-     here's a reason these aren't alphabetically listed.
-     here the ordering of these styles matters for auto-detection. */
-#ifdef SUPPORT_C_STYLE
-    &c_style,
-#endif
-#ifdef SUPPORT_CPLUSPLUS_STYLE
-    &cplusplus_style,
-#endif
-#ifdef SUPPORT_JAVASCRIPT_STYLE
-    &javascript_style,
-#endif
-#ifdef SUPPORT_SHELL_STYLE
-    &shell_style,
-#endif
-#ifdef SUPPORT_SCHEME_STYLE
-    &scheme_style,
-#endif
-#ifdef SUPPORT_TEXINFO_STYLE
-    &texinfo_style,
-#endif
-#ifdef SUPPORT_M4_STYLE
-    &m4_style,
-#endif
-#ifdef SUPPORT_HASKELL_STYLE
-    &haskell_style,
-#endif
-#ifdef SUPPORT_GROFF_STYLE
-    &groff_style,
-#endif
-#ifdef SUPPORT_GETTEXT_STYLE
-    &gettext_style,
-#endif
-#ifdef SUPPORT_FORTRAN_STYLE
-    &fortran_style,
-#endif
-#ifdef SUPPORT_PASCAL_STYLE
-    &pascal_style,
-#endif
-    NULL,
+  OPT_STYLE = -110,
+  OPT_VIEW_ALL,
 };
 
-static const struct argp_child
-parsers[] =
+//the styles that don't have a letter for an option.
+enum
 {
-#ifdef SUPPORT_C_STYLE
-    {&c_style_argp},
-#endif
-#ifdef SUPPORT_CPLUSPLUS_STYLE
-    {&cplusplus_style_argp},
-#endif
-#ifdef SUPPORT_FORTRAN_STYLE
-    {&fortran_style_argp},
-#endif
-#ifdef SUPPORT_GETTEXT_STYLE
-    {&gettext_style_argp},
-#endif
-#ifdef SUPPORT_GROFF_STYLE
-    {&groff_style_argp},
-#endif
-#ifdef SUPPORT_HASKELL_STYLE
-    {&haskell_style_argp},
-#endif
-#ifdef SUPPORT_M4_STYLE
-    {&m4_style_argp},
-#endif
-#ifdef SUPPORT_PASCAL_STYLE
-    {&pascal_style_argp},
-#endif
-#ifdef SUPPORT_SCHEME_STYLE
-    {&scheme_style_argp},
-#endif
-#ifdef SUPPORT_SHELL_STYLE
-    {&shell_style_argp},
-#endif
-#ifdef SUPPORT_TEXINFO_STYLE
-    {&texinfo_style_argp},
-#endif
-    { 0 },
-
+  OPT_SCHEME = -111,
+  OPT_TEXINFO = -112,
+  OPT_M4 = -113,
+  OPT_HASKELL = -114,
+  OPT_GROFF = -115,
+  OPT_GETTEXT = -116,
+  OPT_FORTRAN = -117,
+  OPT_PASCAL = -118,
+  OPT_JAVASCRIPT = -119,
+  OPT_PYTHON = -120,
+  OPT_PERL = -121,
+  OPT_RUBY = -122,
+  OPT_LUA = -123,
+  OPT_SQL = -124,
+  OPT_XML = -125,
+  OPT_CSS = -126,
+  OPT_RUST = -127,
+  OPT_TEX = -128,
+  OPT_LISP = -129,
+  OPT_ERLANG = -130,
+  OPT_OCAML = -131,
+  OPT_VIM = -132,
 };
 
-enum 
+static struct lu_comment_style_t styles[] =
 {
-  OPT_STYLE = -110,
-  OPT_VIEW_ALL,
+  /* okay folks, listen up.
+     here's a reason these aren't alphabetically listed.
+     here the ordering of these styles matters for auto-detection.
+     a style that goes with any file avoids the extensions of the later
+     styles that are made for them, so that those get a chance. */
+    { .name = "c", .key = 'c', .doc = N_("c style comments  e.g. /* foo */"),
+      .open = "/*", .close = "*/", .blocks = "/* */", .lines = "//",
+      .flags = LU_STYLE_LINES_APART,
+      .uncomment = { { "/*", "//", 0, 1 } },
+      .avoid_file_exts = ".css .rs .sql" },
+    { .name = "c++", .key = 'C', .doc = N_("c++ style comments  e.g. // foo"),
+      .open = "//", .blocks = "/* */", .lines = "//",
+      .flags = LU_STYLE_LINES_APART,
+      .uncomment = { { "//", NULL, 1, 0 } },
+      .avoid_file_exts = ".css .rs .sql" },
+    { .name = "javascript", .key = OPT_JAVASCRIPT,
+      .doc = N_("javascript style comments  e.g. // foo"),
+      .open = "//", .blocks = "/* */", .lines = "//", .first_line = "#!",
+      .flags = LU_STYLE_LINES_APART,
+      .uncomment = { { "//", NULL, 1, 0 } },
+      .avoid_file_exts = ".css .rs .sql" },
+    { .name = "shell", .key = 's', .doc = N_("shell style comments  e.g. #foo"),
+      .open = "#", .lines = "#", .first_line = "#!",
+      .uncomment = { { "#", NULL, 0, 0 } },
+      .avoid_file_exts = ".c .h .cpp .hpp .hh .cc .m4 .ac .po .pot "
+                         ".py .pyw .pl .pm .rb" },
+    { .name = "scheme", .key = OPT_SCHEME,
+      .doc = N_("scheme style comments  e.g. ;;;; foo"),
+      .open = ";;;;", .lines = ";", .first_line = "#!",
+      .uncomment = { { ";", NULL, 0, 0 } },
+      .avoid_file_exts = ".el .lisp .lsp .cl" },
+    { .name = "texinfo", .key = OPT_TEXINFO, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("texinfo style comments  e.g. @c foo"),
+      .open = "@c", .lines = "@c|@comment",
+      .uncomment = { { "@comment", "@c", 1, 1 } } },
+    { .name = "m4", .key = OPT_M4, .flags = LU_STYLE_HIDDEN | LU_STYLE_CASELESS,
+      .doc = N_("m4 style comments  e.g. dnl foo"),
+      .open = "dnl", .lines = "dnl|#",
+      .uncomment = { { "dnl", NULL, 1, 0 } },
+      .support_file_exts = ".m4 .ac" },
+    { .name = "haskell", .key = OPT_HASKELL,
+      .doc = N_("haskell style comments  e.g. {- foo -}"),
+      .open = "{-", .close = "-}", .blocks = "{- -}", .lines = "--",
+      .first_line = "#!", .flags = LU_STYLE_LINES_APART,
+      .uncomment = { { "{-}", "--", 0, 1 } },
+      .avoid_file_exts = ".lua .sql" },
+    { .name = "groff", .key = OPT_GROFF, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("groff style comments  e.g. .\\\" foo"),
+      .open = ".\\\"", .lines = ".\\#|\\#|.\\\"|\\\"",
+      .uncomment = { { "\\#", ".\\#", 1, 1 }, { ".\\\"", "\\\"", 1, 1 } } },
+    { .name = "gettext", .key = OPT_GETTEXT, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("gettext style comments  e.g. # foo (the space matters)"),
+      .open = "# ", .lines = "# ",
+      .uncomment = { { "# ", NULL, 1, 0 } },
+      .support_file_exts = ".pot .po" },
+    { .name = "fortran", .key = OPT_FORTRAN, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("fortran style comments  e.g. C foo"),
+      .open = "C", .lines = "C|!",
+      .uncomment = { { "C", "!", 1, 1 } },
+      .support_file_exts = ".f .for .f90 .f95" },
+    { .name = "pascal", .key = OPT_PASCAL,
+      .doc = N_("pascal style comments  e.g. (* foo *)"),
+      .open = "(*", .close = "*)", .blocks = "{ } (* *)", .lines = "//",
+      .flags = LU_STYLE_HIDDEN | LU_STYLE_LINES_APART,
+      .uncomment = { { "{*}", "//", 0, 1 }, { "(*)", "//", 0, 1 } },
+      .avoid_file_exts = ".ml .mli .rs" },
+    { .name = "python", .key = OPT_PYTHON, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("python style comments  e.g. # foo"),
+      .open = "#", .lines = "#", .first_line = "#!",
+      .uncomment = { { "#", NULL, 0, 0 } },
+      .support_file_exts = ".py .pyw" },
+    { .name = "perl", .key = OPT_PERL, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("perl style comments  e.g. # foo"),
+      .open = "#", .lines = "#", .first_line = "#!",
+      .uncomment = { { "#", NULL, 0, 0 } },
+      .support_file_exts = ".pl .pm" },
+    { .name = "ruby", .key = OPT_RUBY, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("ruby style comments  e.g. # foo"),
+      .open = "#", .lines = "#", .first_line = "#!",
+      .uncomment = { { "#", NULL, 0, 0 } },
+      .support_file_exts = ".rb" },
+    { .name = "lua", .key = OPT_LUA, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("lua style comments  e.g. -- foo"),
+      .open = "--", .blocks = "--[[ ]]", .lines = "--", .first_line = "#!",
+      .uncomment = { { "-[]", NULL, 0, 0 } },
+      .support_file_exts = ".lua" },
+    { .name = "sql", .key = OPT_SQL, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("sql style comments  e.g. -- foo"),
+      .open = "--", .blocks = "/* */", .lines = "--",
+      .uncomment = { { "/*", "--", 0, 1 } },
+      .support_file_exts = ".sql" },
+    { .name = "xml", .key = OPT_XML, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("xml style comments  e.g. <!-- foo -->"),
+      .open = "<!--", .close = "-->", .blocks = "<!-- -->",
+      .first_line = "<?xml",
+      .uncomment = { { "<!-->", NULL, 0, 0 } },
+      .support_file_exts = ".xml .xsd .xsl .xslt .xhtml" },
+    { .name = "css", .key = OPT_CSS, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("css style comments  e.g. /* foo */"),
+      .open = "/*", .close = "*/", .blocks = "/* */",
+      .uncomment = { { "/*", NULL, 0, 0 } },
+      .support_file_exts = ".css" },
+    { .name = "rust", .key = OPT_RUST,
+      .doc = N_("rust style comments  e.g. // foo"),
+      .open = "//", .blocks = "/* */", .lines = "//",
+      .flags = LU_STYLE_HIDDEN | LU_STYLE_LINES_APART,
+      .uncomment = { { "//", NULL, 1, 0 } },
+      .support_file_exts = ".rs" },
+    { .name = "tex", .key = OPT_TEX, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("tex style comments  e.g. % foo"),
+      .open = "%", .lines = "%",
+      .uncomment = { { "%", NULL, 0, 0 } },
+      .support_file_exts = ".tex .sty .cls .ltx .dtx" },
+    { .name = "lisp", .key = OPT_LISP, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("lisp style comments  e.g. ;; foo"),
+      .open = ";;", .lines = ";", .first_line = "#!",
+      .uncomment = { { ";", NULL, 0, 0 } },
+      .support_file_exts = ".el .lisp .lsp .cl" },
+    { .name = "erlang", .key = OPT_ERLANG, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("erlang style comments  e.g. %% foo"),
+      .open = "%%", .lines = "%", .first_line = "#!",
+      .uncomment = { { "%", NULL, 0, 0 } },
+      .support_file_exts = ".erl .hrl" },
+    { .name = "ocaml", .key = OPT_OCAML, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("ocaml style comments  e.g. (* foo *)"),
+      .open = "(*", .close = "*)", .blocks = "(* *)",
+      .uncomment = { { "(*)", NULL, 0, 0 } },
+      .support_file_exts = ".ml .mli" },
+    { .name = "vim", .key = OPT_VIM, .flags = LU_STYLE_HIDDEN,
+      .doc = N_("vim script style comments  e.g. \" foo"),
+      .open = "\"", .lines = "\"",
+      .uncomment = { { "\"", NULL, 0, 0 } },
+      .support_file_exts = ".vim" },
 };
-static struct argp_option argp_options[] = 
+
+#define NUM_STYLES (sizeof (styles) / sizeof (styles[0]))
+
+//the styles we support, in the order of auto-detection.
+static struct lu_comment_style_t *lu_styles[NUM_STYLES + 1];
+
+//one option per style, and the two below.
+static struct argp_option argp_options[NUM_STYLES + 3];
+
+static struct argp_option style_argp_options[] =
 {
     {"style", OPT_STYLE, "NAME", OPTION_HIDDEN, N_("specify style by name")},
     {"help-all-styles", OPT_VIEW_ALL, NULL, 0, N_("show more commenting style options and exit")},
-    {0}
 };
 
-char *
-lu_list_of_comment_styles()
+//put a backslash before everything that isn't a letter or a digit.
+static char *
+quote_for_regex (const char *text, size_t len)
+{
+  char *quoted = malloc (len * 2 + 1);
+  char *q = quoted;
+  for (size_t i = 0; i < len; i++)
+    {
+      if (!c_isalnum (text[i]))
+        *q++ = '\\';
+      *q++ = text[i];
+    }
+  *q = '\0';
+  return quoted;
+}
+
+//everything from OPEN up to the first CLOSE.  the loop goes a character
+//of CLOSE at a time so that nothing has to be tried twice.
+static char *
+make_block_regex (const char *open, const char *close)
+{
+  char *o = quote_for_regex (open, strlen (open));
+  char *c = quote_for_regex (close, 1);
+  char *rest = quote_for_regex (&close[1], strlen (&close[1]));
+  char *regex;
+  if (*rest)
+    regex = xasprintf ("%s[^%s]*+(?:%s(?!%s)[^%s]*+)*+%s%s", o, c, c, rest, c,
+                       c, rest);
+  else
+    regex = xasprintf ("%s[^%s]*+%s", o, c, c);
+  free (rest);
+  free (c);
+  free (o);
+  return regex;
+}
+
+//one or more lines starting with any of the prefixes in LINES.
+static char *
+make_lines_regex (const char *lines, int flags)
 {
   char *argz = NULL;
   size_t len = 0;
-  struct lu_comment_style_t **style = &lu_styles[0];
-  while (*style)
+  argz_create_sep (lines, '|', &argz, &len);
+  char *prefixes = NULL;
+  size_t prefixes_len = 0;
+  char *p = NULL;
+  while ((p = argz_next (argz, len, p)))
     {
-      argz_add (&argz, &len, (*style)->name);
-      style++;
+      char *quoted = quote_for_regex (p, strlen (p));
+      char *prefix = xasprintf ("%s%s", quoted,
+                                c_isalpha (p[strlen (p) - 1]) ?
+                                "(?![^ \\t\\r\\n])" : "");
+      argz_add (&prefixes, &prefixes_len, prefix);
+      free (prefix);
+      free (quoted);
     }
-  argz_stringify (argz, len, ' ');
-  return argz;
+  argz_stringify (prefixes, prefixes_len, '|');
+  char *regex;
+  if (flags & LU_STYLE_LINES_APART)
+    regex = xasprintf ("^(?%s:%s).*", flags & LU_STYLE_CASELESS ? "i" : "",
+                       prefixes);
+  else
+    regex = xasprintf ("(?:^(?%s:%s).*[\\r\\n])+",
+                       flags & LU_STYLE_CASELESS ? "i" : "", prefixes);
+  free (prefixes);
+  free (argz);
+  return regex;
+}
+
+//any of the block comments, or the line comments, of STYLE.  it's
+//compiled once here and shared by every thread, which is fine because
+//matching doesn't change a GRegex.  it's compiled as raw bytes so that
+//matching doesn't check the utf-8 of the whole rest of the file every
+//time; the styles do it once per file.
+static GRegex *
+make_style_regex (struct lu_comment_style_t *style)
+{
+  char *argz = NULL;
+  size_t len = 0;
+  if (style->blocks)
+    {
+      char *delimiters = NULL;
+      size_t delimiters_len = 0;
+      argz_create_sep (style->blocks, ' ', &delimiters, &delimiters_len);
+      char *open = NULL;
+      while ((open = argz_next (delimiters, delimiters_len, open)))
+        {
+          char *close = argz_next (delimiters, delimiters_len, open);
+          if (!close)
+            break;
+          char *regex = make_block_regex (open, close);
+          argz_add (&argz, &len, regex);
+          free (regex);
+          open = close;
+        }
+      free (delimiters);
+    }
+  if (style->lines)
+    {
+      char *regex = make_lines_regex (style->lines, style->flags);
+      argz_add (&argz, &len, regex);
+      free (regex);
+    }
+  argz_stringify (argz, len, '|');
+  char *expr = xasprintf ("(%s)", argz ? argz : "");
+  free (argz);
+  GRegex *regex = g_regex_new (expr, G_REGEX_MULTILINE | G_REGEX_EXTENDED |
+                               G_REGEX_RAW, 0, NULL);
+  free (expr);
+  return regex;
 }
 
-static int 
-match_file_extension (char *extensions, char *filename)
+static int
+is_enabled (const char *name)
 {
+  if (strcmp (COMMENTING_STYLES, "all") == 0)
+    return 1;
+  char *argz = NULL;
+  size_t len = 0;
+  argz_create_sep (COMMENTING_STYLES, ' ', &argz, &len);
+  int found = 0;
+  char *s = NULL;
+  while ((s = argz_next (argz, len, s)))
+    if (strcmp (s, name) == 0)
+      found = 1;
+  free (argz);
+  return found;
+}
+
+static int
+has_extension (char *extensions, const char *ext)
+{
+  if (!extensions)
+    return 0;
   int found = 0;
-  char *ext = strrchr (filename, '.');
-  if (!ext)
-    return found;
   char *argz = NULL;
   size_t len = 0;
   argz_create_sep (extensions, ' ', &argz, &len);
@@ -196,38 +373,299 @@ match_file_extension (char *extensions, char *filename)
   return found;
 }
 
-struct lu_comment_style_t *
-auto_detect_comment_blocks (char *filename, FILE *fp, char **argz, size_t *len, char **hashbang)
+//the styles to try on a file with extension EXT: the ones made for EXT
+//or for any file, leaving out the ones that avoid EXT.  they stay in
+//the order of lu_styles, which is the order they're tried in.
+static struct lu_comment_style_t **
+make_candidate_styles (const char *ext)
 {
-  char *hashbang_throwaway = NULL;
-  char **h = hashbang;
-  if (!h)
-    h = &hashbang_throwaway;
+  struct lu_comment_style_t **candidates =
+    calloc (NUM_STYLES + 1, sizeof (struct lu_comment_style_t *));
+  int n = 0;
+  for (struct lu_comment_style_t **style = &lu_styles[0]; *style; style++)
+    {
+      if ((*style)->support_file_exts &&
+          !(ext && has_extension ((*style)->support_file_exts, ext)))
+        continue;
+      if (ext && has_extension ((*style)->avoid_file_exts, ext))
+        continue;
+      candidates[n++] = *style;
+    }
+  return candidates;
+}
+
+static char *
+lowercase_extension (const char *ext)
+{
+  char *lower = strdup (ext);
+  for (char *c = lower; *c; c++)
+    *c = c_tolower (*c);
+  return lower;
+}
+
+//every extension that a style is made for or avoids, and the styles to
+//try on a file with that extension.  the other files get the styles in
+//candidates_for_any_file.
+static GHashTable *candidates_by_extension;
+static struct lu_comment_style_t **candidates_for_any_file;
+
+static void
+add_candidate_styles (char *extensions)
+{
+  char *argz = NULL;
+  size_t len = 0;
+  argz_create_sep (extensions, ' ', &argz, &len);
+  char *e = NULL;
+  while ((e = argz_next (argz, len, e)))
+    {
+      char *ext = lowercase_extension (e);
+      if (g_hash_table_contains (candidates_by_extension, ext))
+        free (ext);
+      else
+        g_hash_table_insert (candidates_by_extension, ext,
+                             make_candidate_styles (ext));
+    }
+  free (argz);
+}
+
+static void
+index_styles_by_extension ()
+{
+  candidates_by_extension = g_hash_table_new (g_str_hash, g_str_equal);
+  candidates_for_any_file = make_candidate_styles (NULL);
+  struct lu_comment_style_t **style;
+  for (style = &lu_styles[0]; *style; style++)
+    {
+      if ((*style)->support_file_exts)
+        add_candidate_styles ((*style)->support_file_exts);
+      if ((*style)->avoid_file_exts)
+        add_candidate_styles ((*style)->avoid_file_exts);
+    }
+}
+
+static struct lu_comment_style_t **
+get_candidate_styles (char *filename)
+{
+  char *ext = strrchr (filename, '.');
+  if (!ext)
+    return candidates_for_any_file;
+  char *lower = lowercase_extension (ext);
+  struct lu_comment_style_t **candidates =
+    g_hash_table_lookup (candidates_by_extension, lower);
+  free (lower);
+  return candidates ? candidates : candidates_for_any_file;
+}
+
+void
+lu_init_comment_styles ()
+{
+  if (lu_styles[0])
+    return;
+  int n = 0;
+  for (int i = 0; i < NUM_STYLES; i++)
+    {
+      struct lu_comment_style_t *style = &styles[i];
+      if (!is_enabled (style->name))
+        continue;
+      style->regex = make_style_regex (style);
+      argp_options[n].name = xasprintf ("%s-style", style->name);
+      argp_options[n].key = style->key;
+      argp_options[n].flags = style->flags & LU_STYLE_HIDDEN ?
+        OPTION_HIDDEN : 0;
+      argp_options[n].doc = style->doc;
+      lu_styles[n++] = style;
+    }
+  argp_options[n++] = style_argp_options[0];
+  argp_options[n++] = style_argp_options[1];
+  index_styles_by_extension ();
+}
+
+char *
+lu_list_of_comment_styles()
+{
+  char *argz = NULL;
+  size_t len = 0;
   struct lu_comment_style_t **style = &lu_styles[0];
   while (*style)
     {
-      rewind (fp);
-      int match = 0;
-      if ((*style)->support_file_exts)
+      argz_add (&argz, &len, (*style)->name);
+      style++;
+    }
+  argz_stringify (argz, len, ' ');
+  return argz;
+}
+
+//read FP to look for comments in, but no more of it than the memory
+//budget.  the comments can't go past a nul, and like always there aren't
+//any in a file that isn't utf-8.
+static char *
+read_text (FILE *fp, size_t *data_len)
+{
+  gint64 start = lu_stats_start ();
+  char *data = lu_read_head (fp, data_len, NULL);
+  lu_stats_stop (LU_STATS_READ_TIME, start);
+  if (!data)
+    return NULL;
+  lu_stats_add (LU_STATS_FILES_READ, 1);
+  lu_stats_add (LU_STATS_BYTES_READ, *data_len);
+  *data_len = strlen (data);
+  if (!g_utf8_validate (data, *data_len, NULL))
+    {
+      free (data);
+      return NULL;
+    }
+  return data;
+}
+
+//how long the first line of DATA is, when STYLE keeps it out of the
+//comments.
+static size_t
+get_first_line_length (struct lu_comment_style_t *style, char *data)
+{
+  if (!style->first_line ||
+      strncmp (data, style->first_line, strlen (style->first_line)) != 0)
+    return 0;
+  char *nl = strchr (data, '\n');
+  return nl ? nl - data + 1 : strlen (data);
+}
+
+int
+lu_get_initial_comment (struct lu_comment_style_t *style, FILE *fp, char **argz, size_t *len, char **hashbang)
+{
+  long startpos = ftell (fp);
+  size_t data_len = 0;
+  char *data = read_text (fp, &data_len);
+  if (!data)
+    return *len > 0;
+  size_t skip = 0;
+  if (hashbang)
+    {
+      skip = get_first_line_length (style, data);
+      if (skip)
         {
-          if (match_file_extension ((*style)->support_file_exts, filename))
-            match = 1;
+          free (*hashbang);
+          *hashbang = strndup (data, skip);
         }
-      else
-        match = 1;
+    }
+  size_t length = find_comment_blocks (&data[skip], data_len - skip,
+                                       style->regex, argz, len);
+  //fp goes after the comments, or stays at the end when there aren't any.
+  if (length)
+    fseek (fp, startpos + skip + length, SEEK_SET);
+  free (data);
+  return *len > 0;
+}
 
-      if ((*style)->avoid_file_exts && 
-          match_file_extension ((*style)->avoid_file_exts, filename))
-        match = 0;
+char *
+lu_comment_in_style (struct lu_comment_style_t *style, char *text)
+{
+  if (style->close)
+    return create_block_comment (text, style->open, style->close);
+  return create_line_comment (text, style->open);
+}
 
-      if (match && (*style)->get_initial_comment (fp, argz, len, h))
-        break;
+void
+lu_uncomment_in_style (struct lu_comment_style_t *style, char **argz, size_t *len, int trim)
+{
+  for (int i = 0; i < 2 && style->uncomment[i].delimiters; i++)
+    {
+      struct lu_uncomment_rule_t *rule = &style->uncomment[i];
+      uncomment_comments (argz, len, rule->delimiters,
+                          rule->synonymous_delimiter, trim,
+                          rule->first_literal, rule->second_literal);
+    }
+}
 
-      style++;
+//look for comments in STYLE at the start of DATA, and put FP after them.
+static int
+try_comment_style (struct lu_comment_style_t *style, char *data, size_t data_len, FILE *fp, char **argz, size_t *len, char **hashbang)
+{
+  size_t skip = get_first_line_length (style, data);
+  size_t length = find_comment_blocks (&data[skip], data_len - skip,
+                                       style->regex, argz, len);
+  if (!length)
+    return 0;
+  if (hashbang && skip)
+    {
+      free (*hashbang);
+      *hashbang = strndup (data, skip);
+    }
+  fseek (fp, skip + length, SEEK_SET);
+  return 1;
+}
+
+//the file is read once.  when its extension doesn't tell us anything,
+//the start of the file might say which style it's in.  otherwise the
+//styles that might be in it are tried one after the other.
+struct lu_comment_style_t *
+auto_detect_comment_blocks (char *filename, FILE *fp, char **argz, size_t *len, char **hashbang)
+{
+  rewind (fp);
+  size_t data_len = 0;
+  char *data = read_text (fp, &data_len);
+  if (!data)
+    return NULL;
+  struct lu_comment_style_t *found = NULL;
+  struct lu_comment_style_t **style = get_candidate_styles (filename);
+  struct lu_comment_style_t *classified = NULL;
+  if (style == candidates_for_any_file)
+    classified = lu_classify_comment_style (data, data_len);
+  if (classified &&
+      try_comment_style (classified, data, data_len, fp, argz, len, hashbang))
+    found = classified;
+  for (; *style && !found; style++)
+    if (*style != classified &&
+        try_comment_style (*style, data, data_len, fp, argz, len, hashbang))
+      found = *style;
+  free (data);
+  return found;
+}
+
+//the comments at the top of FILENAME in STYLE, or in the style that's
+//auto-detected when STYLE is NULL.  when the file hasn't changed since
+//the scan cache last saw it, FP isn't read at all.  the scan cache keeps
+//the name of the style that was found, followed by the comments.
+struct lu_comment_style_t *
+lu_get_comment_blocks_of_file (struct lu_comment_style_t *style, char *filename, FILE *fp, char **argz, size_t *len)
+{
+  struct stat st;
+  memset (&st, 0, sizeof (st));
+  if (strcmp (filename, "-") != 0)
+    fstat (fileno (fp), &st);
+  char *kind = xasprintf ("comments-%s", style ? style->name : "auto");
+  struct lu_comment_style_t *found = NULL;
+  char *saved = NULL;
+  size_t saved_len = 0;
+  if (lu_scan_cache_lookup (kind, filename, &st, &saved, &saved_len))
+    {
+      size_t name_len = strlen (saved) + 1;
+      if (saved[0])
+        found = lu_lookup_comment_style (saved);
+      if (saved_len > name_len)
+        {
+          *len = saved_len - name_len;
+          *argz = malloc (*len);
+          memcpy (*argz, &saved[name_len], *len);
+        }
+    }
+  else
+    {
+      if (style == NULL)
+        found = auto_detect_comment_blocks (filename, fp, argz, len, NULL);
+      else if (lu_get_initial_comment (style, fp, argz, len, NULL))
+        found = style;
+      const char *name = found ? found->name : "";
+      size_t name_len = strlen (name) + 1;
+      saved_len = name_len + *len;
+      saved = malloc (saved_len);
+      memcpy (saved, name, name_len);
+      if (*len)
+        memcpy (&saved[name_len], *argz, *len);
+      lu_scan_cache_store (kind, filename, &st, saved, saved_len);
     }
-  if (hashbang_throwaway)
-    free (hashbang_throwaway);
-  return (*style);
+  free (saved);
+  free (kind);
+  return found;
 }
 
 struct lu_comment_style_t *
@@ -255,7 +693,6 @@ lu_is_a_comment_style (char *arg)
   return lu_lookup_comment_style (arg) == NULL ? 0 : 1;
 }
 
-      
 static void
 show_all_comment_style_options()
 {
@@ -263,19 +700,14 @@ show_all_comment_style_options()
   printf (" Commenting Style Options:\n");
   while (*style)
     {
-      const struct argp_option *options = &(*style)->argp->options[0];
-      while (options->key)
-        {
-          char opt[2];
-          opt[0]=options->key;
-          opt[1]='\0';
-          printf ("  %s%s%s    %s%-20s %s\n", 
-                  isalnum(options->key) ? "-" : " ",
-                  isalnum(options->key) ? opt : " ",
-                  isalnum(options->key) ? "," : " ",
-                  options->name ? "--" : "  ", options->name, options->doc);
-          options++;
-        }
+      char *name = xasprintf ("%s-style", (*style)->name);
+      int key = (*style)->key;
+      printf ("  %s%c%s    --%-20s %s\n",
+              c_isalnum (key) ? "-" : " ",
+              c_isalnum (key) ? key : ' ',
+              c_isalnum (key) ? "," : " ",
+              name, (*style)->doc);
+      free (name);
       style++;
     }
 }
@@ -325,22 +757,19 @@ parse_opt (int key, char *arg, struct argp_state *state)
           argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
         }
       break;
-    case ARGP_KEY_INIT:
+    default:
         {
-          int i = 0;
           struct lu_comment_style_t **s = &lu_styles[0];
-          while (*s)
-            {
-              state->child_inputs[i] = style;
-              i++;
-              s++;
-            }
+          for (; *s; s++)
+            if ((*s)->key == key)
+              {
+                *style = *s;
+                return 0;
+              }
         }
-      break;
-    default:
       return ARGP_ERR_UNKNOWN;
     }
   return 0;
 }
 
-struct argp styles_argp = { argp_options, parse_opt, "", "", parsers};
+struct argp styles_argp = { argp_options, parse_opt, "", "", 0};
@@ -26,5 +26,10 @@ struct lu_comment_style_t * lu_lookup_comment_style (char *arg);
 int lu_is_a_comment_style (char *arg);
 char * lu_list_of_comment_styles();
 struct lu_comment_style_t * auto_detect_comment_blocks (char *filename, FILE *fp, char **argz, size_t *len, char **hashbang);
+struct lu_comment_style_t * lu_get_comment_blocks_of_file (struct lu_comment_style_t *style, char *filename, FILE *fp, char **argz, size_t *len);
 struct lu_comment_style_t * lu_get_current_commenting_style();
+void lu_init_comment_styles ();
+int lu_get_initial_comment (struct lu_comment_style_t *style, FILE *fp, char **argz, size_t *len, char **hashbang);
+char * lu_comment_in_style (struct lu_comment_style_t *style, char *text);
+void lu_uncomment_in_style (struct lu_comment_style_t *style, char **argz, size_t *len, int trim);
 #endif
@@ -0,0 +1,320 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ctype.h"
+#include "svg-comments.h"
+#include "image-formats.h"
+#include "util.h"
+
+/* the comment goes in the prolog of the xml, which is everything before
+   the root element.  only the prolog is looked at, and after that the
+   file is copied as it is, so it doesn't matter how big the drawing is. */
+
+enum token_kind
+{
+  WHITESPACE, PROCESSING_INSTRUCTION, COMMENT, DOCTYPE, ROOT
+};
+
+struct token_t
+{
+  enum token_kind kind;
+  char *buf;
+  size_t len;
+  size_t size;
+};
+
+static const unsigned char bom[3] = { 0xef, 0xbb, 0xbf };
+
+static int
+is_space (int c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int
+add (struct token_t *token, int c)
+{
+  if (token->len + 1 >= token->size)
+    {
+      size_t size = token->size ? token->size * 2 : 256;
+      char *bigger = realloc (token->buf, size);
+      if (!bigger)
+        return -1;
+      token->buf = bigger;
+      token->size = size;
+    }
+  token->buf[token->len++] = c;
+  token->buf[token->len] = '\0';
+  return 0;
+}
+
+static int
+ends_with (struct token_t *token, const char *end)
+{
+  size_t len = strlen (end);
+  return token->len >= len &&
+    memcmp (&token->buf[token->len - len], end, len) == 0;
+}
+
+//keep reading into TOKEN until it ends with END.
+static int
+read_until (FILE *fp, struct token_t *token, const char *end)
+{
+  while (!ends_with (token, end))
+    {
+      int c = getc (fp);
+      if (c == EOF)
+        return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+      if (add (token, c))
+        return -1;
+    }
+  return 0;
+}
+
+static int
+read_token (FILE *fp, struct token_t *token)
+{
+  token->len = 0;
+  int c = getc (fp);
+  if (c == EOF)
+    return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+  if (add (token, c))
+    return -1;
+  if (is_space (c))
+    {
+      token->kind = WHITESPACE;
+      while (is_space (c = getc (fp)))
+        if (add (token, c))
+          return -1;
+      if (c != EOF)
+        ungetc (c, fp);
+      return 0;
+    }
+  if (c != '<')
+    return LU_IMAGE_MALFORMED;
+  c = getc (fp);
+  if (c == EOF)
+    return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+  if (add (token, c))
+    return -1;
+  if (c == '?')
+    {
+      token->kind = PROCESSING_INSTRUCTION;
+      return read_until (fp, token, "?>");
+    }
+  else if (c != '!')
+    {
+      token->kind = ROOT;
+      return 0;
+    }
+  for (int i = 0; i < 2; i++)
+    {
+      c = getc (fp);
+      if (c == EOF)
+        return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+      if (add (token, c))
+        return -1;
+    }
+  if (strcmp (token->buf, "<!--") == 0)
+    {
+      token->kind = COMMENT;
+      return read_until (fp, token, "-->");
+    }
+  //the doctype can have an internal subset in brackets with more
+  //declarations in it.
+  token->kind = DOCTYPE;
+  int depth = 0;
+  while (1)
+    {
+      c = getc (fp);
+      if (c == EOF)
+        return ferror (fp) ? -1 : LU_IMAGE_MALFORMED;
+      if (add (token, c))
+        return -1;
+      if (c == '[')
+        depth++;
+      else if (c == ']')
+        depth--;
+      else if (c == '>' && depth <= 0)
+        break;
+    }
+  return 0;
+}
+
+static void
+skip_bom (FILE *fp, FILE *out)
+{
+  unsigned char buf[sizeof (bom)];
+  size_t n = fread (buf, 1, sizeof (buf), fp);
+  if (n == sizeof (bom) && memcmp (buf, bom, sizeof (bom)) == 0)
+    {
+      if (out)
+        fwrite (buf, 1, n, out);
+    }
+  else
+    fseeko (fp, -(off_t) n, SEEK_CUR);
+}
+
+//the root element has to be <svg>, and it comes after a prolog that
+//can be any size, so the prolog is read a token at a time until then.
+int
+lu_svg_detect (FILE *fp)
+{
+  skip_bom (fp, NULL);
+  struct token_t token;
+  memset (&token, 0, sizeof (token));
+  int found = 0;
+  while (read_token (fp, &token) == 0)
+    {
+      if (token.kind != ROOT)
+        continue;
+      int c;
+      while ((c = getc (fp)) != EOF && !is_space (c) && c != '>' && c != '/')
+        if (add (&token, c))
+          break;
+      const char *name = &token.buf[1];
+      const char *colon = strrchr (name, ':');
+      if (colon)
+        name = colon + 1;
+      found = strcmp (name, "svg") == 0;
+      break;
+    }
+  free (token.buf);
+  return found;
+}
+
+//a comment is only the boilerplate when it has a copyright notice in it,
+//or it's the same as TEXT.  other ones like `<!-- Created with Inkscape -->'
+//aren't ours to touch.
+static int
+is_boilerplate (struct token_t *token, const char *text, size_t len)
+{
+  static const char word[] = "copyright";
+  char *start = &token->buf[4];
+  char *end = &token->buf[token->len - 3];
+  if (*start == '\n')
+    start++;
+  if (text && (size_t) (end - start) >= len &&
+      memcmp (start, text, len) == 0)
+    return 1;
+  for (char *p = start; p + sizeof (word) - 1 <= end; p++)
+    {
+      size_t i = 0;
+      while (i < sizeof (word) - 1 && c_tolower (p[i]) == word[i])
+        i++;
+      if (i == sizeof (word) - 1)
+        return 1;
+    }
+  return 0;
+}
+
+int
+lu_svg_get_comment (FILE *fp, char **text)
+{
+  *text = NULL;
+  skip_bom (fp, NULL);
+  struct token_t token;
+  memset (&token, 0, sizeof (token));
+  int err = 0;
+  while (!(err = read_token (fp, &token)) && token.kind != ROOT)
+    {
+      if (token.kind == COMMENT && is_boilerplate (&token, NULL, 0))
+        {
+          char *start = &token.buf[4];
+          if (*start == '\n')
+            start++;
+          *text = strndup (start, &token.buf[token.len - 3] - start);
+          break;
+        }
+    }
+  free (token.buf);
+  return err;
+}
+
+//two dashes in a row would end the comment, so a space goes between them.
+static void
+write_comment (FILE *out, const char *text, size_t len)
+{
+  fputs ("<!--\n", out);
+  int prev = 0;
+  for (size_t i = 0; i < len; i++)
+    {
+      if (text[i] == '-' && prev == '-')
+        putc (' ', out);
+      putc (text[i], out);
+      prev = text[i];
+    }
+  if (len == 0 || text[len - 1] != '\n')
+    putc ('\n', out);
+  fputs ("-->", out);
+}
+
+int
+lu_svg_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags)
+{
+  skip_bom (fp, out);
+  struct token_t token;
+  memset (&token, 0, sizeof (token));
+  int first = 1;
+  int replaced = 0;
+  int after_comment = 0;
+  int err = 0;
+  while (!(err = read_token (fp, &token)))
+    {
+      //only the first comment that is the boilerplate goes, and the
+      //other ones like `<!-- Generator: ... -->' stay where they are.
+      if (token.kind == COMMENT && !replaced &&
+          is_boilerplate (&token, text, len))
+        {
+          replaced = 1;
+          after_comment = 1;
+          continue;
+        }
+      size_t start = 0;
+      //a comment we take out takes the end of its line with it.
+      if (after_comment && token.kind == WHITESPACE)
+        {
+          char *newline = memchr (token.buf, '\n', token.len);
+          start = newline ? newline - token.buf + 1 : token.len;
+        }
+      after_comment = 0;
+      int declaration = token.kind == PROCESSING_INSTRUCTION &&
+        strncmp (token.buf, "<?xml", 5) == 0 && is_space (token.buf[5]);
+      if (first && text && !declaration)
+        {
+          write_comment (out, text, len);
+          putc ('\n', out);
+        }
+      fwrite (&token.buf[start], 1, token.len - start, out);
+      //the xml declaration has to stay at the very start.
+      if (first && text && declaration)
+        {
+          putc ('\n', out);
+          write_comment (out, text, len);
+        }
+      first = 0;
+      if (token.kind == ROOT)
+        break;
+    }
+  free (token.buf);
+  if (err)
+    return err;
+  return copy_rest_of_file (fp, out);
+}
@@ -0,0 +1,37 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#ifndef LU_SVG_COMMENTS_H
+#define LU_SVG_COMMENTS_H 1
+
+#include <config.h>
+#include <stdio.h>
+
+//whether the file at FP has an <svg> root element.  FP is left somewhere
+//after the prolog.
+int lu_svg_detect (FILE *fp);
+
+//put the first comment with a copyright notice in it before the root
+//element of the svg at FP into *TEXT, or NULL if there isn't one.
+int lu_svg_get_comment (FILE *fp, char **text);
+
+//copy the svg at FP to OUT, putting TEXT in a comment in place of the
+//first comment before the root element that has a copyright notice in it
+//or is the same as TEXT.  other comments stay where they are.  when TEXT
+//is NULL that comment is just taken out.
+int lu_svg_splice_comment (FILE *fp, FILE *out, const char *text, size_t len, int flags);
+#endif
@@ -27,6 +27,8 @@
 #include "error.h"
 #include "util.h"
 #include "styles.h"
+#include "arena.h"
+#include "result-cache.h"
 
 enum
 {
@@ -95,29 +97,43 @@ lu_uncomment_parse_argp (struct lu_state_t *state, int argc, char **argv)
     return err;
 }
 
+//the same comments are at the top of many files.
+static void
+uncomment_blocks (struct lu_comment_style_t *style, char **argz, size_t *len, int trim)
+{
+  char *key = NULL;
+  size_t key_len = 0;
+  argz_add (&key, &key_len, style->name);
+  argz_add (&key, &key_len, trim ? "trim" : "");
+  argz_append (&key, &key_len, *argz, *len);
+  char *result = NULL;
+  size_t result_len = 0;
+  if (lu_result_cache_lookup ("uncomment", key, key_len, &result, &result_len))
+    {
+      free (*argz);
+      *argz = result;
+      *len = result_len;
+    }
+  else
+    {
+      lu_uncomment_in_style (style, argz, len, trim);
+      lu_result_cache_store ("uncomment", key, key_len, *argz, *len);
+    }
+  free (key);
+}
+
 static int
-lu_uncomment_file (struct lu_state_t *state, struct lu_uncomment_options_t *opts, char *file)
+lu_uncomment_stream (struct lu_state_t *state, struct lu_uncomment_options_t *opts, FILE *fp, char *file)
 {
   char *comment_blocks = NULL;
   size_t len = 0;
-  FILE *fp = fopen (file, "r");
-  if (!fp)
-    return 0;
-  if (is_a_file (file) == 0)
-    {
-      if (errno == EISDIR)
-        error (0, errno, "%s", file);
-      else
-        error (0, errno, N_("could not open `%s' for reading"), file);
-      return 0;
-    }
   if (opts->style == NULL)
     opts->style = auto_detect_comment_blocks (file, fp, &comment_blocks, &len, NULL);
   else
-    opts->style->get_initial_comment (fp, &comment_blocks, &len, NULL);
+    lu_get_initial_comment (opts->style, fp, &comment_blocks, &len, NULL);
 
-  if (opts->style)
-    opts->style->uncomment (&comment_blocks, &len, opts->trim);
+  if (opts->style && comment_blocks)
+    uncomment_blocks (opts->style, &comment_blocks, &len, opts->trim);
 
   if (comment_blocks)
     {
@@ -132,44 +148,44 @@ lu_uncomment_file (struct lu_state_t *state, struct lu_uncomment_options_t *opts
       size_t linelen = 0;
       ssize_t read = getline (&line, &linelen, fp);
       if (read != -1 && strspn (line, "\n\r\t\v ") != strlen (line))
-        luprintf (state, "%s", line);
+        luwrite (state, line, read);
       if (read != -1)
-        while ((read = getline (&line, &linelen, fp)) != -1) 
-          luprintf (state , "%s", line);
+        lucopy (state, fp);
       free (line);
     }
-  fclose (fp);
+  lu_arena_reset (lu_arena_get ());
 
   return 0;
 }
 
 static int
-lu_uncomment_from_stdin (struct lu_state_t *state, struct lu_uncomment_options_t *options)
+lu_uncomment_file (struct lu_state_t *state, struct lu_uncomment_options_t *opts, char *file)
 {
-  int err = 0;
-  char tmp[sizeof(PACKAGE) + 13];
-  snprintf (tmp, sizeof tmp, "/tmp/%s.XXXXXX", PACKAGE);
-  int fd = mkstemp(tmp);
-  close (fd);
-  FILE *fileptr = fopen (tmp, "w");
-  if (fileptr)
+  FILE *fp = fopen (file, "r");
+  if (!fp)
+    return 0;
+  if (is_a_file (file) == 0)
     {
-      char *line = NULL;
-      size_t len = 0;
-      ssize_t read;
-
-      while ((read = getline(&line, &len, stdin)) != -1)
-        fprintf (fileptr, "%s", line);
-
-      free (line);
-      fflush (fileptr);
-      fsync (fileno (fileptr));
-      fclose (fileptr);
-      err = lu_uncomment_file (state, options, tmp);
-      remove (tmp);
+      if (errno == EISDIR)
+        error (0, errno, "%s", file);
+      else
+        error (0, errno, N_("could not open `%s' for reading"), file);
+      fclose (fp);
+      return 0;
     }
-  else
-    err = -1;
+  int err = lu_uncomment_stream (state, opts, fp, file);
+  fclose (fp);
+  return err;
+}
+
+static int
+lu_uncomment_from_stdin (struct lu_state_t *state, struct lu_uncomment_options_t *options)
+{
+  FILE *fp = open_stdin_copy ();
+  if (!fp)
+    return -1;
+  int err = lu_uncomment_stream (state, options, fp, "-");
+  fclose (fp);
   return err;
 }
 
@@ -0,0 +1,306 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <argz.h>
+#include <sys/stat.h>
+#include "licensing_priv.h"
+#include "update-years.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "util.h"
+#include "styles.h"
+#include "copyright.h"
+#include "batch.h"
+#include "git-years.h"
+#include "result-cache.h"
+
+static struct argp_option argp_options[] =
+{
+    {"year", 'y', "YEAR", 0, N_("add YEAR instead of the current year")},
+    {"git", 'g', NULL, 0,
+      N_("add the years that each file was committed in")},
+    {"abbreviate-years", 'a', NULL, 0,
+      N_("abbreviate the years if possible")},
+    {"dry-run", 'd', NULL, 0, N_("show which files would change")},
+    {"no-backup", 'n', NULL, 0,
+      N_("don't retain original source file in a .bak file")},
+    {"jobs", 'j', "NUM", 0, N_("update NUM files at a time")},
+    {"quiet", 'q', NULL, 0, N_("don't show diagnostic messages")},
+    {0}
+};
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  struct lu_update_years_options_t *opt = NULL;
+  if (state)
+    opt = (struct lu_update_years_options_t*) state->input;
+  switch (key)
+    {
+    case 'y':
+        {
+          char *end = NULL;
+          long int year = strtol (arg, &end, 10);
+          if (end == arg || *end != '\0' || year < 1900 ||
+              year >= 1900 + COPYRIGHT_MAX_YEARS)
+            {
+              argp_failure (state, 0, 0, N_("`%s' is an invalid year"), arg);
+              argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+            }
+          else
+            {
+              opt->year = year;
+              opt->year_given = 1;
+            }
+        }
+      break;
+    case 'g':
+      opt->git = 1;
+      break;
+    case 'a':
+      opt->abbreviate_years = 1;
+      break;
+    case 'd':
+      opt->dry_run = 1;
+      break;
+    case 'n':
+      opt->backup = 0;
+      break;
+    case 'j':
+      opt->jobs = lu_batch_parse_jobs (arg);
+      if (opt->jobs == -1)
+        {
+          argp_failure (state, 0, 0,
+                        N_("`%s' is an invalid number of jobs"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    case 'q':
+      opt->quiet = 1;
+      break;
+    case ARGP_KEY_ARG:
+      argz_add (&opt->input_files, &opt->input_files_len, arg);
+      break;
+    case ARGP_KEY_INIT:
+      opt->input_files = NULL;
+      opt->input_files_len = 0;
+      opt->year = get_current_year ();
+      opt->year_given = 0;
+      opt->git = 0;
+      opt->git_years = NULL;
+      opt->abbreviate_years = 0;
+      opt->backup = 1;
+      opt->dry_run = 0;
+      opt->quiet = 0;
+      opt->jobs = lu_batch_default_jobs ();
+      opt->style = NULL;
+      state->child_inputs[0] = &opt->style;
+      break;
+    case ARGP_KEY_FINI:
+      if (opt->input_files == NULL)
+        {
+          argp_failure (state, 0, 0, N_("no files specified"));
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
+static struct argp_child parsers[]=
+{
+    { &styles_argp, 0, N_("Commenting Style Options:"), 0 },
+    { 0 }
+};
+
+#undef UPDATE_YEARS_DOC
+#define UPDATE_YEARS_DOC \
+  N_("Add this year to the copyright notices in files.") "\v"\
+  N_("Only copyright notices in the comments at the top of each file are changed.") "  "\
+  N_("Directories are searched recursively.") "  "\
+  N_("Comment style is auto-detected if a style option is not provided.") "  "\
+  N_("Modified files are backed-up into files with a .bak suffix.") "  "\
+  N_("Years are abbreviated into ranges when the notice already has a range in it.") "  "\
+  N_("With --git, the years come from the history of each file instead of the current year, unless --year is also given.")
+static struct argp argp = { argp_options, parse_opt, "FILE...",
+  UPDATE_YEARS_DOC, parsers};
+
+int
+lu_update_years_parse_argp (struct lu_state_t *state, int argc, char **argv)
+{
+  int err = 0;
+  struct lu_update_years_options_t opts;
+  opts.state = state;
+
+  err = argp_parse (&argp, argc, argv, state->argp_flags,  0, &opts);
+  if (!err)
+    return lu_update_years (state, &opts);
+  else
+    return err;
+}
+
+//write the new file beside the old one and then move it into place.
+//HEADER goes first, and then the REST of the old file is copied over.
+static int
+replace_file (struct lu_update_years_options_t *options, char *file, char *header, FILE *rest, char **report)
+{
+  char *tmp = NULL;
+  FILE *fp = open_replacement_file (file, &tmp);
+  if (!fp)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for writing"), tmp,
+                                  errno);
+      free (tmp);
+      return -1;
+    }
+  fwrite (header, 1, strlen (header), fp);
+  int err = copy_rest_of_file (rest, fp) || ferror (fp);
+  if (fclose (fp) != 0)
+    err = -1;
+  if (err)
+    {
+      *report = lu_batch_failure (N_("could not write `%s'"), tmp, errno);
+      remove (tmp);
+      free (tmp);
+      return -1;
+    }
+  if (commit_replacement_file (tmp, file, options->backup) != 0)
+    {
+      *report = lu_batch_failure (N_("could not write `%s'"), file, errno);
+      free (tmp);
+      return -1;
+    }
+  free (tmp);
+  return 0;
+}
+
+//the files in a tree mostly have the same few headers, and the years
+//that go in them are usually the same too.
+static char *
+get_updated_header (char *header, int *add, int abbreviate)
+{
+  char *argz = NULL;
+  size_t len = 0;
+  argz_add (&argz, &len, abbreviate ? "abbreviate" : "");
+  for (int i = 0; i < COPYRIGHT_MAX_YEARS; i++)
+    if (add[i])
+      {
+        char *year = xasprintf ("%d", 1900 + i);
+        argz_add (&argz, &len, year);
+        free (year);
+      }
+  argz_add (&argz, &len, header);
+  char *updated = NULL;
+  size_t updated_len = 0;
+  if (!lu_result_cache_lookup ("update-years", argz, len, &updated,
+                               &updated_len))
+    {
+      updated = update_copyright_years (header, add, 0, abbreviate);
+      lu_result_cache_store ("update-years", argz, len, updated,
+                             updated ? strlen (updated) : 0);
+    }
+  free (argz);
+  return updated;
+}
+
+static int
+update_years_in_file (void *data, char *file, char **output, char **report)
+{
+  struct lu_update_years_options_t *options = data;
+  FILE *fp = fopen (file, "r");
+  if (!fp)
+    {
+      *report = lu_batch_failure (N_("could not open `%s' for reading"), file,
+                                  errno);
+      return -1;
+    }
+  char *header = get_comments_and_whitespace (fp, file, options->style);
+  if (!header)
+    {
+      fclose (fp);
+      return 0;
+    }
+  int add[COPYRIGHT_MAX_YEARS];
+  memset (add, 0, sizeof (add));
+  if (options->git_years)
+    lu_git_years_lookup (options->git_years, file, add);
+  if (!options->git || options->year_given)
+    add[options->year - 1900] = 1;
+  char *updated = get_updated_header (header, add, options->abbreviate_years);
+  free (header);
+  if (!updated)
+    {
+      fclose (fp);
+      return 0;
+    }
+
+  int err = 0;
+  if (options->dry_run)
+    {
+      if (options->quiet == 0)
+        *report = xasprintf (N_("%s -> Copyright years would be updated."),
+                             file);
+    }
+  else
+    {
+      err = replace_file (options, file, updated, fp, report);
+      if (!err && options->quiet == 0)
+        *report = xasprintf (N_("%s -> Copyright years updated."), file);
+    }
+  free (updated);
+  fclose (fp);
+  return err;
+}
+
+int
+lu_update_years (struct lu_state_t *state, struct lu_update_years_options_t *options)
+{
+  int err = 0;
+  char *files = NULL;
+  size_t files_len = 0;
+  char *f = NULL;
+  while ((f = argz_next (options->input_files, options->input_files_len, f)))
+    {
+      if (lu_collect_files (f, 1, &files, &files_len))
+        err = -1;
+    }
+  if (options->git)
+    options->git_years = lu_git_years_new (files, files_len);
+  if (lu_batch (state, files, files_len, options->jobs, update_years_in_file,
+                options))
+    err = -1;
+  if (options->git_years)
+    lu_git_years_free (options->git_years);
+  free (files);
+  free (options->input_files);
+  return err;
+}
+
+struct lu_command_t update_years =
+{
+  .name         = N_("update-years"),
+  .doc          = UPDATE_YEARS_DOC,
+  .flags        = SHOW_IN_HELP | SAVE_IN_HISTORY,
+  .argp         = &argp,
+  .parser       = lu_update_years_parse_argp
+};
@@ -31,6 +31,7 @@
 #include "error.h"
 #include "url-downloader.h"
 #include "md2.h"
+#include "stats.h"
 
 static char *
 url_to_checksum (const char *url)
@@ -73,11 +74,15 @@ download (struct lu_state_t *state, char *url, char **data)
   FILE *fileptr = fopen (filename, "r");
   if (fileptr)
     {
+      lu_stats_add (LU_STATS_CACHE_HITS, 1);
       *data = fread_file (fileptr, &data_len);
       fclose (fileptr);
       return 0;
     }
+  lu_stats_add (LU_STATS_CACHE_MISSES, 1);
+  lu_stats_add (LU_STATS_DOWNLOADS, 1);
   int err = 0;
+  gint64 start = lu_stats_start ();
   fileptr = fopen (filename, "wb");
   curl_easy_setopt (state->curl, CURLOPT_HTTPGET, 1);
   curl_easy_setopt (state->curl, CURLOPT_URL, url);
@@ -85,7 +90,9 @@ download (struct lu_state_t *state, char *url, char **data)
   curl_easy_perform(state->curl);
   fflush (fileptr);
   fsync (fileno (fileptr));
+  lu_stats_add (LU_STATS_FSYNCS, 1);
   fclose (fileptr);
+  lu_stats_stop (LU_STATS_DOWNLOAD_TIME, start);
   int response = 0;
   curl_easy_getinfo (state->curl, CURLINFO_RESPONSE_CODE, &response);
   if (response != 200)
@@ -106,6 +113,11 @@ clear_download_cache ()
 {
   char *dir = xasprintf ("%s/.licenseutils/cache", getenv ("HOME"));
   DIR *d = opendir (dir);
+  if (!d)
+    {
+      free (dir);
+      return;
+    }
   struct dirent *entry;
   while ((entry=readdir(d)))
     {
@@ -118,4 +130,5 @@ clear_download_cache ()
 
   closedir (d);
   rmdir (dir);
+  free (dir);
 }
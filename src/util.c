@@ -18,18 +18,25 @@
 
 #include <config.h>
 #include <string.h>
+#include <ctype.h>
 #include <glib.h>
 #include <stdlib.h>
 #include <argz.h>
+#include <unistd.h>
+#include <errno.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 #include "licensing_priv.h"
 #include "util.h"
-#include "trim.h"
 #include "read-file.h"
 #include "xvasprintf.h"
 #include "gettext-more.h"
 #include "error.h"
 #include "styles.h"
+#include "arena.h"
+#include "stats.h"
 
 static int
 find_start_of_matching_text (char *text, const char *match)
@@ -155,33 +162,30 @@ get_hashbang_or_rewind (FILE *fp, char **hashbang)
     }
 }
 
+//return the text matching REGEX at the very start of DATA.  the match is
+//anchored, so a file without a comment at the top isn't searched to the
+//end, and LEN saves the regex library from measuring DATA every time.
 char *
-get_comment_by_regex (char *data, const char *expr)
+get_comment_by_regex (char *data, size_t len, GRegex *regex)
 {
   char *comment = NULL;
   GMatchInfo *matches = NULL;
-  GError *err = NULL;
-  GRegex * regex = 
-    g_regex_new (expr, G_REGEX_MULTILINE | G_REGEX_EXTENDED, 0, &err);
-  gboolean matched = g_regex_match (regex, data, 0, &matches);
+  if (!regex)
+    return NULL;
+  gint64 start = lu_stats_start ();
+  gboolean matched = g_regex_match_full (regex, data, len, 0,
+                                         G_REGEX_MATCH_ANCHORED, &matches,
+                                         NULL);
+  lu_stats_stop (LU_STATS_REGEX_TIME, start);
   if (matched)
     {
-      int n = g_match_info_get_match_count (matches);
-      for (int i = 0; i < n; i++)
-        {
-          gint start_pos = 0, end_pos = 0;
-          g_match_info_fetch_pos (matches, i, &start_pos, &end_pos);
-          if (start_pos == 0)
-            {
-              if (strlen (g_match_info_fetch (matches, i)) > 0)
-                {
-                  comment = strdup (g_match_info_fetch (matches, i));
-                  break;
-                }
-            }
-        }
-      g_match_info_free(matches);
+      lu_stats_add (LU_STATS_REGEX_MATCHES, 1);
+      gint start_pos = 0, end_pos = 0;
+      g_match_info_fetch_pos (matches, 0, &start_pos, &end_pos);
+      if (end_pos > 0)
+        comment = strndup (data, end_pos);
     }
+  g_match_info_free (matches);
   return comment;
 }
 
@@ -239,144 +243,169 @@ can_apply(char *progname)
   return 1;
 }
 
+//the lines of a comment, which live in the arena until they're joined.
+struct lines_t
+{
+  char **line;
+  size_t count;
+};
+
+static void
+init_lines (struct lu_arena_t *arena, struct lines_t *lines, const char *text)
+{
+  size_t max = 2;
+  for (const char *nl = text; (nl = strchr (nl, '\n')); nl++)
+    max++;
+  lines->line = lu_arena_alloc (arena, sizeof (char *) * max);
+  lines->count = 0;
+}
+
+static void
+add_line (struct lines_t *lines, char *line)
+{
+  lines->line[lines->count++] = line;
+}
+
+//like argz_stringify, but the result is in the arena too.
+static char *
+join_lines (struct lu_arena_t *arena, struct lines_t *lines)
+{
+  size_t len = 0;
+  for (size_t i = 0; i < lines->count; i++)
+    len += strlen (lines->line[i]) + 1;
+  char *text = lu_arena_alloc (arena, len + 1);
+  char *p = text;
+  for (size_t i = 0; i < lines->count; i++)
+    {
+      if (i)
+        *p++ = '\n';
+      p = stpcpy (p, lines->line[i]);
+    }
+  *p = '\0';
+  return text;
+}
+
+//how many of the characters at the end of S (which is LEN long) are in SET.
+static size_t
+strspn_end (const char *s, size_t len, const char *set)
+{
+  size_t n = 0;
+  while (n < len && strchr (set, s[len - n - 1]))
+    n++;
+  return n;
+}
+
+static size_t
+trailing_whitespace (const char *s, size_t len)
+{
+  size_t n = 0;
+  while (n < len && isspace ((unsigned char) s[len - n - 1]))
+    n++;
+  return n;
+}
+
 char *
 create_block_comment (char *text, char *open_delimiter, char *close_delimiter)
 {
   if (text == NULL)
     return xasprintf ("%s %s", open_delimiter, close_delimiter);
-  char *argz = NULL;
-  size_t len = 0;
-  //size_t length=0;
-  //size_t length = strspn (text, " \t\r\n\v");
-  //text+=length;
-  //add 3 spaces to the start of every line
-  char *nl = strchr (text, '\n');
-  //if (nl)
-    {
-      //but treat the first line specially. 
-      if(nl)
-        nl[0] = '\0';
-      //char *trimmed = trim (text);
-      char *line = xasprintf ("%s %s", open_delimiter, text);
-      //free (trimmed);
-      argz_add (&argz, &len, line);
-      free (line);
-      if (nl)
-        text = ++nl;
-    }
+  struct lu_arena_t *arena = lu_arena_get ();
+  struct lines_t lines;
+  init_lines (arena, &lines, text);
+  //but treat the first line specially. 
+  size_t length = strcspn (text, "\n");
+  add_line (&lines, lu_arena_printf (arena, "%s %.*s", open_delimiter,
+                                     (int) length, text));
+  text += length;
+  if (*text)
+    text++;
+  //add 3 spaces to the start of every other line
+  char *nl;
   while ((nl = strchr (text, '\n')))
     {
-      nl[0] = '\0';
-      char *line = xasprintf ("   %s", text);
-      argz_add (&argz, &len, line);
-      free (line);
+      add_line (&lines, lu_arena_printf (arena, "   %.*s", (int) (nl - text),
+                                         text));
       text = ++nl;
     }
-  if (argz)
-    {
-      //we treat the last line specially too.
-      //add the closing delimiter if it will fit.
-      int lines = argz_count (argz, len);
-      char *last_line = NULL;
-      while (lines-- != 0)
-        last_line = argz_next (argz, len, last_line);
-      if (strlen (last_line) + strlen (close_delimiter) < 78)
-        {
-          char *l = trim_trailing (last_line);
-          argz_delete (&argz, &len, last_line);
-          char *line = xasprintf ("%s %s\n", l, close_delimiter);
-          free (l);
-          argz_add (&argz, &len, line);
-          free (line);
-        }
-      else if (strlen (last_line) + strlen (close_delimiter) < 79)
-        {
-          //squeeze the space if we have to
-          char *l = trim_trailing (last_line);
-          argz_delete (&argz, &len, last_line);
-          char *line = xasprintf ("%s%s\n", l, close_delimiter);
-          free (l);
-          argz_add (&argz, &len, line);
-          free (line);
-        }
-      else
-        argz_add (&argz, &len, "*/\n");
 
-      argz_stringify (argz, len, '\n');
-      return argz;
-    }
-  return NULL;
-}
-
-//remove delimiters from the start and ends of lines in *COMMENT.
-static void
-uncomment_comment (char **comment, char *delimiters, char *synonymous_delimiter, int whitespace, int first_literal, int second_literal)
-{
-  char *argz = NULL;
-  size_t len = 0;
-  char *c = *comment;
-  //add a newline if necessary
-  if (c[strlen (c)-1] != '\n')
+  //we treat the last line specially too.
+  //add the closing delimiter if it will fit.
+  char *last_line = lines.line[lines.count - 1];
+  size_t last_len = strlen (last_line);
+  size_t l = last_len - trailing_whitespace (last_line, last_len);
+  if (last_len + strlen (close_delimiter) < 78)
+    lines.line[lines.count - 1] =
+      lu_arena_printf (arena, "%.*s %s\n", (int) l, last_line,
+                       close_delimiter);
+  else if (last_len + strlen (close_delimiter) < 79)
     {
-      char *newc = xasprintf("%s\n", c);
-      free (c);
-      c = newc;
+      //squeeze the space if we have to
+      lines.line[lines.count - 1] =
+        lu_arena_printf (arena, "%.*s%s\n", (int) l, last_line,
+                         close_delimiter);
     }
   else
-    {
-      c = strdup (*comment);
-      free (*comment);
-    }
+    add_line (&lines, "*/\n");
+
+  return strdup (join_lines (arena, &lines));
+}
 
+//remove delimiters from the start and ends of lines in COMMENT.
+static char *
+uncomment_comment (struct lu_arena_t *arena, char *comment, char *delimiters, char *synonymous_delimiter, int whitespace, int first_literal, int second_literal)
+{
+  struct lines_t lines;
+  init_lines (arena, &lines, comment);
+  char *c = comment;
   while (*c)
     {
-      char *nl = strchr (c, '\n');
-      if (nl)
-        nl[0] = '\0';
-      char *t = trim (c);
-      if (t)
+      size_t length = strcspn (c, "\n");
+      char *next = c[length] ? &c[length + 1] : &c[length];
+      while (length && isspace ((unsigned char) *c))
+        c++, length--;
+      length -= trailing_whitespace (c, length);
+      char *t = lu_arena_strndup (arena, c, length);
+      c = next;
+
+      size_t start = 0;
+      if (!first_literal)
+        start = strspn (t, delimiters);
+      else
+        {
+          if (strncmp (t, delimiters, strlen (delimiters)) == 0)
+            start = strlen (delimiters);
+        }
+      if (start == 0 && synonymous_delimiter)
         {
-          size_t start = 0;
-          if (!first_literal)
-            start = strspn (t, delimiters);
+          if (!second_literal)
+            start = strspn (t, synonymous_delimiter);
           else
             {
-              if (strncmp (t, delimiters, strlen (delimiters)) == 0)
-                start = strlen (delimiters);
-            }
-          if (start == 0 && synonymous_delimiter)
-            {
-              if (!second_literal)
-                start = strspn (t, synonymous_delimiter);
-              else
-                {
-                  if (strncmp (t, synonymous_delimiter, 
-                               strlen (synonymous_delimiter)) == 0)
-                    start = strlen (synonymous_delimiter);
-                }
+              if (strncmp (t, synonymous_delimiter, 
+                           strlen (synonymous_delimiter)) == 0)
+                start = strlen (synonymous_delimiter);
             }
-          char *rev = strdup (t+start);
-          g_strreverse (rev);
-          size_t end = 0;
-          if (!first_literal)
-            end = strspn (rev, delimiters);
-          if (!second_literal && end == 0 && synonymous_delimiter)
-            end = strspn (rev, synonymous_delimiter);
-          free (rev);
-          t[strlen (t)-end] = '\0';
-          if (strlen (t+start) == 0 && whitespace)
-            ;
-          else
-            argz_add (&argz, &len, t+start);
-          free (t);
         }
-      c = ++nl;
+      size_t end = 0;
+      if (!first_literal)
+        end = strspn_end (t + start, length - start, delimiters);
+      if (!second_literal && end == 0 && synonymous_delimiter)
+        end = strspn_end (t + start, length - start, synonymous_delimiter);
+      t[length - end] = '\0';
+      t += start;
+      length -= start + end;
+      if (whitespace)
+        {
+          //skip the lines that were only delimiters, and trim the rest.
+          if (length == 0)
+            continue;
+          while (isspace ((unsigned char) *t))
+            t++, length--;
+          t[length - trailing_whitespace (t, length)] = '\0';
+        }
+      add_line (&lines, t);
     }
-
-  argz_stringify (argz, len, '\n');
-  *comment = argz;
-  if (whitespace)
-    uncomment_comment (comment, " \t", NULL, 0, 0, 0);
+  return join_lines (arena, &lines);
 }
 
 void
@@ -385,15 +414,13 @@ uncomment_comments (char **argz, size_t *len, char *delimiters, char *synonymous
   char *new_argz = NULL;
   size_t new_len = 0;
 
+  struct lu_arena_t *arena = lu_arena_get ();
   char *comment = NULL;
   while ((comment = argz_next (*argz, *len, comment)))
-    {
-      char *c = strdup(comment);
-      uncomment_comment (&c, delimiters, synonymous_delimiter, whitespace, 
-                         first_literal, second_literal);
-      argz_add (&new_argz, &new_len, c);
-      free (c);
-    }
+    argz_add (&new_argz, &new_len,
+              uncomment_comment (arena, comment, delimiters,
+                                 synonymous_delimiter, whitespace,
+                                 first_literal, second_literal));
   free (*argz);
   *argz = new_argz;
   *len = new_len;
@@ -404,56 +431,43 @@ create_line_comment (char *text, char *delimiter)
 {
   if (text == NULL)
     return xasprintf ("%s ", delimiter);
-  char *argz = NULL;
-  size_t len = 0;
   size_t length = strspn (text, " \t\r\n\v");
   text+=length;
+  if (strchr (text, '\n') == NULL)
+    return xasprintf ("%s %s", delimiter, text);
+  struct lu_arena_t *arena = lu_arena_get ();
+  struct lines_t lines;
+  init_lines (arena, &lines, text);
   char *nl;
   while ((nl = strchr (text, '\n')))
     {
-      nl[0] = '\0';
-      char *line = xasprintf ("%s %s", delimiter, text);
-      argz_add (&argz, &len, line);
-      free (line);
+      add_line (&lines, lu_arena_printf (arena, "%s %.*s", delimiter,
+                                         (int) (nl - text), text));
       text = ++nl;
     }
-  if (argz)
-    {
-      argz_add (&argz, &len, "");
-      argz_stringify (argz, len, '\n');
-      return argz;
-    }
-  else
-    return xasprintf ("%s %s", delimiter, text);
-  return NULL;
+  add_line (&lines, "");
+  return strdup (join_lines (arena, &lines));
 }
 
-int
-get_comment_blocks (FILE *fp, char **argz, size_t *len, char **hashbang, char *regex)
+//put the comments matching REGEX at the start of DATA into ARGZ, and
+//return how much of DATA they take up along with the whitespace after
+//them, or 0 when there aren't any.
+size_t
+find_comment_blocks (char *data, size_t data_len, GRegex *regex, char **argz, size_t *len)
 {
-  long startpos = ftell (fp);
-  size_t data_len;
-  char *data = fread_file (fp, &data_len);
-  size_t length = 0;
+  size_t length = strspn (data, "\r\n\t \v");
+  int found = 0;
   char *c;
-  size_t whitespace = strspn (&data[length], "\r\n\t \v");
-  if (whitespace)
-    length += whitespace;
-  while ((c = get_comment_by_regex (&data[length], regex)))
+  while ((c = get_comment_by_regex (&data[length], data_len - length,
+                                    regex)))
     {
       argz_add (argz, len, c);
       length += strlen (c);
-      fseek (fp, startpos+length, SEEK_SET);
-      whitespace = strspn (&data[length], "\r\n\t \v");
-      if (whitespace)
-        {
-          length += whitespace;
-          fseek (fp, startpos+length, SEEK_SET);
-        }
-      //printf("data is now: '%s'\n", &data[length]);
+      free (c);
+      length += strspn (&data[length], "\r\n\t \v");
+      found = 1;
     }
-  free (data);
-  return *len > 0;
+  return found ? length : 0;
 }
 
 char *
@@ -465,7 +479,7 @@ get_comments_and_whitespace (FILE *fp, char *file, struct lu_comment_style_t *st
   if (style == NULL)
     auto_detect_comment_blocks (file, fp, &argz, &len, NULL);
   else
-    style->get_initial_comment (fp, &argz, &len, NULL);
+    lu_get_initial_comment (style, fp, &argz, &len, NULL);
 
   free (argz);
   //fp now points to after the boilerplate if there is any.
@@ -473,11 +487,10 @@ get_comments_and_whitespace (FILE *fp, char *file, struct lu_comment_style_t *st
   fseek (fp, start, SEEK_SET);
   if (len == 0)
     return NULL;
-  size_t data_len;
-  char *data = fread_file (fp, &data_len);
-  data[pos-start]='\0';
-  char *comments = strdup (data);
-  free (data);
+  //only the comments are read, not the rest of the file.
+  char *comments = malloc (pos - start + 1);
+  size_t comments_len = fread (comments, 1, pos - start, fp);
+  comments[comments_len] = '\0';
   fseek (fp, pos, SEEK_SET);
 
   return comments;
@@ -503,3 +516,235 @@ replace_fsf_address (char **chunk, int fsf_address, char *license, int num_space
       free (address);
     }
 }
+
+//open a new file beside FILE to write its replacement into.
+//the name of it goes into *TMP.
+FILE *
+open_replacement_file (char *file, char **tmp)
+{
+  *tmp = xasprintf ("%s.XXXXXX", file);
+  int fd = mkstemp (*tmp);
+  if (fd == -1)
+    return NULL;
+  lu_stats_add (LU_STATS_TEMP_FILES, 1);
+  struct stat st;
+  if (stat (file, &st) == 0)
+    fchmod (fd, st.st_mode);
+  FILE *fp = fdopen (fd, "wb");
+  if (!fp)
+    {
+      close (fd);
+      remove (*tmp);
+    }
+  return fp;
+}
+
+//move TMP over FILE, keeping the old one as FILE.bak if BACKUP is set.
+//TMP is removed if anything goes wrong, and errno says what it was.
+int
+commit_replacement_file (char *tmp, char *file, int backup)
+{
+  if (backup)
+    {
+      char *bak = xasprintf ("%s.bak", file);
+      remove (bak);
+      int err = link (file, bak) != 0 && rename (file, bak) != 0;
+      free (bak);
+      if (err)
+        {
+          int saved_errno = errno;
+          remove (tmp);
+          errno = saved_errno;
+          return -1;
+        }
+    }
+  if (rename (tmp, file) != 0)
+    {
+      int saved_errno = errno;
+      remove (tmp);
+      errno = saved_errno;
+      return -1;
+    }
+  lu_stats_add (LU_STATS_FILES_WRITTEN, 1);
+  return 0;
+}
+
+//copy everything in FP from where it's at now over to OUT.
+//the kernel does the copying where it can, so that the data doesn't
+//have to come through our buffers.
+static int
+copy_file_contents (FILE *fp, FILE *out, off_t *bytes)
+{
+  if (fflush (out) != 0)
+    return -1;
+  off_t offset = ftello (fp);
+  int in_fd = fileno (fp);
+  int out_fd = fileno (out);
+  if (offset != -1 && in_fd != -1 && out_fd != -1)
+    {
+      off_t begin = offset;
+      ssize_t copied = -1;
+#ifdef HAVE_COPY_FILE_RANGE
+      while ((copied = copy_file_range (in_fd, &offset, out_fd, NULL,
+                                        1 << 30, 0)) > 0)
+        ;
+#endif
+#ifdef HAVE_SENDFILE
+      //this one works when OUT is a pipe, or on another filesystem.
+      if (copied == -1)
+        while ((copied = sendfile (out_fd, in_fd, &offset, 1 << 30)) > 0)
+          ;
+#endif
+      *bytes += offset - begin;
+      if (fseeko (fp, offset, SEEK_SET) != 0)
+        return -1;
+      if (copied == 0)
+        return 0;
+    }
+
+  //one of them isn't a real file, like when FP is a pipe.
+  char buf[65536];
+  size_t n;
+  while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+    {
+      if (fwrite (buf, 1, n, out) != n)
+        return -1;
+      *bytes += n;
+    }
+  return ferror (fp) || ferror (out) ? -1 : 0;
+}
+
+int
+copy_rest_of_file (FILE *fp, FILE *out)
+{
+  off_t bytes = 0;
+  gint64 start = lu_stats_start ();
+  int err = copy_file_contents (fp, out, &bytes);
+  lu_stats_stop (LU_STATS_WRITE_TIME, start);
+  lu_stats_add (LU_STATS_BYTES_WRITTEN, bytes);
+  return err;
+}
+
+static size_t memory_budget = LU_DEFAULT_MEMORY_BUDGET;
+
+void
+lu_set_memory_budget (size_t budget)
+{
+  memory_budget = budget;
+}
+
+size_t
+lu_get_memory_budget ()
+{
+  return memory_budget;
+}
+
+char *
+lu_read_head (FILE *fp, size_t *len, int *more)
+{
+  size_t size = 65536 < memory_budget ? 65536 : memory_budget;
+  char *buf = malloc (size + 1);
+  *len = 0;
+  size_t n;
+  while (buf && (n = fread (&buf[*len], 1, size - *len, fp)) > 0)
+    {
+      *len += n;
+      if (*len == size)
+        {
+          if (size >= memory_budget)
+            break;
+          size = size * 2 < memory_budget ? size * 2 : memory_budget;
+          char *bigger = realloc (buf, size + 1);
+          if (!bigger)
+            {
+              error (0, errno, N_("could not read the standard input"));
+              free (buf);
+              return NULL;
+            }
+          buf = bigger;
+        }
+    }
+  if (!buf || ferror (fp))
+    {
+      free (buf);
+      return NULL;
+    }
+  buf[*len] = '\0';
+  if (more)
+    {
+      int c = getc (fp);
+      *more = c != EOF;
+      if (*more)
+        ungetc (c, fp);
+    }
+  return buf;
+}
+
+//read the standard input into a stream that can be rewound.  it's kept
+//in memory unless there's more of it than the memory budget, and then it
+//goes into a temporary file that is gone when the stream is closed.
+//returns NULL, after saying why, when it can't be done.
+FILE *
+open_stdin_copy ()
+{
+  size_t size = 65536;
+  size_t len = 0;
+  char *buf = malloc (size);
+  if (!buf)
+    {
+      error (0, errno, N_("could not read the standard input"));
+      return NULL;
+    }
+  size_t n;
+  int spill = 0;
+  while ((n = fread (&buf[len], 1, size - len, stdin)) > 0)
+    {
+      len += n;
+      if (len == size)
+        {
+          if (size >= memory_budget)
+            {
+              spill = 1;
+              break;
+            }
+          size = size * 2 < memory_budget ? size * 2 : memory_budget;
+          char *bigger = realloc (buf, size);
+          if (!bigger)
+            {
+              error (0, errno, N_("could not read the standard input"));
+              free (buf);
+              return NULL;
+            }
+          buf = bigger;
+        }
+    }
+  lu_stats_add (LU_STATS_BYTES_READ, len);
+  FILE *fp = NULL;
+#ifdef HAVE_FMEMOPEN
+  //the extra byte is for the null that fmemopen puts after the text.
+  if (!spill)
+    fp = fmemopen (NULL, len + 1, "w+");
+#endif
+  if (!fp)
+    {
+      fp = tmpfile ();
+      lu_stats_add (LU_STATS_TEMP_FILES, 1);
+    }
+  if (fp)
+    {
+      int err = fwrite (buf, 1, len, fp) != len;
+      if (!err && spill)
+        err = copy_rest_of_file (stdin, fp);
+      if (err || fflush (fp) != 0)
+        {
+          fclose (fp);
+          fp = NULL;
+        }
+      else
+        rewind (fp);
+    }
+  if (!fp)
+    error (0, errno, N_("could not read the standard input"));
+  free (buf);
+  return fp;
+}
@@ -25,14 +25,29 @@ int show_lines_after (struct lu_state_t *state, char *text, const char *match, i
 int is_a_file_where_hash_includes_are_not_comments (char *filename);
 void replace_html_entities (char *text);
 int can_apply(char *progname);
-char * get_comment_by_regex (char *data, const char *expr);
+char * get_comment_by_regex (char *data, size_t len, GRegex *regex);
 char * create_block_comment (char *text, char *open_delimiter, char *close_delimiter);
 void uncomment_comments (char **argz, size_t *len, char *delimiters, char *synonymous_delimiter, int whitespace, int first_literal, int second_literal);
 char * create_line_comment (char *text, char *delimiter);
 void get_hashbang_or_rewind (FILE *fp, char **hashbang);
-int get_comment_blocks (FILE *fp, char **argz, size_t *len, char **hashbang, char *regex);
+size_t find_comment_blocks (char *data, size_t data_len, GRegex *regex, char **argz, size_t *len);
 char * get_comments_and_whitespace (FILE *fp, char *file, struct lu_comment_style_t *style);
 char * get_lines (char *text, const char *match, int lines);
 int text_replace (char *text, char *search, char *replace);
 void replace_fsf_address (char **chunk, int fsf_address, char *license, int num_spaces);
+FILE * open_replacement_file (char *file, char **tmp);
+int commit_replacement_file (char *tmp, char *file, int backup);
+int copy_rest_of_file (FILE *fp, FILE *out);
+FILE * open_stdin_copy ();
+
+//no more than this much of any one file is kept in memory.  the rest of
+//a file is streamed, or isn't read at all.
+#define LU_DEFAULT_MEMORY_BUDGET (8 * 1024 * 1024)
+#define LU_MIN_MEMORY_BUDGET (4 * 1024)
+void lu_set_memory_budget (size_t budget);
+size_t lu_get_memory_budget ();
+
+//read up to the memory budget from FP, and null-terminate it.  MORE is
+//set when there's more of FP after that.
+char * lu_read_head (FILE *fp, size_t *len, int *more);
 #endif
@@ -0,0 +1,561 @@
+/*  Copyright (C) 2016 Ben Asselstine
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <argz.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <glib.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+#include "licensing_priv.h"
+#include "watch.h"
+#include "gettext-more.h"
+#include "xvasprintf.h"
+#include "error.h"
+#include "styles.h"
+#include "batch.h"
+#include "detect.h"
+#include "arena.h"
+
+static struct argp_option argp_options[] =
+{
+    {"expect", 'e', "LICENSE", 0,
+      N_("report the files that have a license other than LICENSE")},
+    {"once", 'o', NULL, 0, N_("show the report once and exit")},
+    {0}
+};
+
+static int
+is_a_license_keyword (char *arg)
+{
+  char *keywords = lu_list_of_license_keywords ();
+  char *argz = NULL;
+  size_t len = 0;
+  argz_create_sep (keywords, ' ', &argz, &len);
+  free (keywords);
+  int found = 0;
+  char *keyword = NULL;
+  while ((keyword = argz_next (argz, len, keyword)))
+    if (strcmp (keyword, arg) == 0)
+      found = 1;
+  free (argz);
+  return found;
+}
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  struct lu_watch_options_t *opt = NULL;
+  if (state)
+    opt = (struct lu_watch_options_t*) state->input;
+  switch (key)
+    {
+    case 'e':
+      if (is_a_license_keyword (arg))
+        argz_add (&opt->expected_licenses, &opt->expected_licenses_len, arg);
+      else
+        {
+          argp_failure (state, 0, 0, N_("`%s' is not a license"), arg);
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    case 'o':
+      opt->once = 1;
+      break;
+    case ARGP_KEY_ARG:
+      argz_add (&opt->input_files, &opt->input_files_len, arg);
+      break;
+    case ARGP_KEY_INIT:
+      opt->input_files = NULL;
+      opt->input_files_len = 0;
+      opt->expected_licenses = NULL;
+      opt->expected_licenses_len = 0;
+      opt->once = 0;
+      opt->style = NULL;
+      state->child_inputs[0] = &opt->style;
+      break;
+    case ARGP_KEY_FINI:
+      if (opt->input_files == NULL)
+        {
+          argp_failure (state, 0, 0, N_("no directories specified"));
+          argp_state_help (state, stderr, ARGP_HELP_STD_ERR);
+        }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
+static struct argp_child parsers[]=
+{
+    { &styles_argp, 0, N_("Commenting Style Options:"), 0 },
+    { 0 }
+};
+
+#undef WATCH_DOC
+#define WATCH_DOC \
+  N_("Report the files without boilerplate in a tree, and keep watching it.") "\v"\
+  N_("The files in each DIR are looked at once, and the files without boilerplate are shown.") "  "\
+  N_("After that, only the files that are changed, created or moved into DIR are looked at again, and the files whose state changes are shown.") "  "\
+  N_("With --expect, the files with boilerplate that isn't like one of the expected licenses are shown too.") "  "\
+  N_("Comment style is auto-detected if a style option is not provided.")
+static struct argp argp = { argp_options, parse_opt, "DIR...", WATCH_DOC,
+  parsers};
+
+int
+lu_watch_parse_argp (struct lu_state_t *state, int argc, char **argv)
+{
+  int err = 0;
+  struct lu_watch_options_t opts;
+  opts.state = state;
+
+  err = argp_parse (&argp, argc, argv, state->argp_flags,  0, &opts);
+  if (!err)
+    return lu_watch (state, &opts);
+  else
+    return err;
+}
+
+enum watched_file_state_t
+{
+  WATCHED_FILE_OK,
+  WATCHED_FILE_NO_BOILERPLATE,
+  WATCHED_FILE_UNEXPECTED_LICENSE,
+};
+
+struct watched_file_t
+{
+  enum watched_file_state_t state;
+  char *license;
+};
+
+//the files that are being watched, and the directories they're in.
+struct watch_index_t
+{
+  GHashTable *files;
+  GHashTable *directories;
+  int fd;
+  //only made when some licenses are expected.
+  struct lu_license_notices_t *notices;
+};
+
+static void
+free_watched_file (gpointer f)
+{
+  struct watched_file_t *file = f;
+  free (file->license);
+  free (file);
+}
+
+static int
+is_expected (struct lu_watch_options_t *options, char *license)
+{
+  if (!license)
+    return 0;
+  char *expected = NULL;
+  while ((expected = argz_next (options->expected_licenses,
+                                options->expected_licenses_len, expected)))
+    if (strcmp (expected, license) == 0)
+      return 1;
+  return 0;
+}
+
+static int
+has_boilerplate (struct lu_watch_options_t *options, char *file)
+{
+  FILE *fp = fopen (file, "r");
+  if (!fp)
+    return 0;
+  char *comment_blocks = NULL;
+  size_t len = 0;
+  lu_get_comment_blocks_of_file (options->style, file, fp, &comment_blocks,
+                                 &len);
+  fclose (fp);
+  int found = comment_blocks != NULL;
+  free (comment_blocks);
+  return found;
+}
+
+//the licenses are only worked out when some of them are expected.
+static struct watched_file_t *
+look_at_file (struct lu_state_t *state, struct lu_watch_options_t *options, struct watch_index_t *index, char *file)
+{
+  struct watched_file_t *watched = malloc (sizeof (struct watched_file_t));
+  watched->state = WATCHED_FILE_OK;
+  watched->license = NULL;
+  struct lu_comment_style_t *found = NULL;
+  if (!options->expected_licenses)
+    {
+      if (!has_boilerplate (options, file))
+        watched->state = WATCHED_FILE_NO_BOILERPLATE;
+    }
+  else if (!lu_detect_license_of_file (state, file, options->style,
+                                       lu_license_notices_match,
+                                       index->notices, &found,
+                                       &watched->license))
+    watched->state = WATCHED_FILE_NO_BOILERPLATE;
+  else if (!is_expected (options, watched->license))
+    watched->state = WATCHED_FILE_UNEXPECTED_LICENSE;
+  return watched;
+}
+
+static void
+show_watched_file (struct lu_state_t *state, char *file, struct watched_file_t *watched)
+{
+  switch (watched->state)
+    {
+    case WATCHED_FILE_OK:
+      luprintf (state, N_("%s: ok\n"), file);
+      break;
+    case WATCHED_FILE_NO_BOILERPLATE:
+      luprintf (state, N_("%s: no boilerplate\n"), file);
+      break;
+    case WATCHED_FILE_UNEXPECTED_LICENSE:
+      if (watched->license)
+        luprintf (state, N_("%s: unexpected license `%s'\n"), file,
+                  watched->license);
+      else
+        luprintf (state, N_("%s: unknown license\n"), file);
+      break;
+    }
+}
+
+static int
+same_state (struct watched_file_t *l, struct watched_file_t *r)
+{
+  if (l->state != r->state)
+    return 0;
+  if (l->license && r->license)
+    return strcmp (l->license, r->license) == 0;
+  return l->license == r->license;
+}
+
+//look at FILE again, and show it when its state changes.  a file that
+//is new to the index is only shown when something is wrong with it.
+static int
+update_file (struct lu_state_t *state, struct lu_watch_options_t *options, struct watch_index_t *index, char *file)
+{
+  struct stat st;
+  if (lstat (file, &st) != 0 || !S_ISREG (st.st_mode))
+    return 0;
+  struct watched_file_t *watched = look_at_file (state, options, index,
+                                                 file);
+  //watch goes on for as long as it's left running.
+  lu_arena_reset (lu_arena_get ());
+  struct watched_file_t *old = g_hash_table_lookup (index->files, file);
+  int changed = 0;
+  if (old ? !same_state (old, watched) : watched->state != WATCHED_FILE_OK)
+    {
+      show_watched_file (state, file, watched);
+      changed = 1;
+    }
+  g_hash_table_replace (index->files, strdup (file), watched);
+  return changed;
+}
+
+//forget about FILE, or all of the files in it when it's a directory.
+static int
+forget_file (struct lu_state_t *state, struct watch_index_t *index, char *file)
+{
+  char *prefix = xasprintf ("%s/", file);
+  int changed = 0;
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init (&iter, index->files);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      struct watched_file_t *watched = value;
+      if (strcmp (key, file) != 0 && strncmp (key, prefix, strlen (prefix)))
+        continue;
+      if (watched->state != WATCHED_FILE_OK)
+        {
+          luprintf (state, N_("%s: gone\n"), (char *) key);
+          changed = 1;
+        }
+      g_hash_table_iter_remove (&iter);
+    }
+  free (prefix);
+  return changed;
+}
+
+static void
+show_summary (struct lu_state_t *state, struct watch_index_t *index)
+{
+  int counts[WATCHED_FILE_UNEXPECTED_LICENSE + 1];
+  memset (counts, 0, sizeof (counts));
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init (&iter, index->files);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    counts[((struct watched_file_t *) value)->state]++;
+  luprintf (state,
+            N_("%d files, %d without boilerplate, %d with unexpected licenses\n"),
+            g_hash_table_size (index->files),
+            counts[WATCHED_FILE_NO_BOILERPLATE],
+            counts[WATCHED_FILE_UNEXPECTED_LICENSE]);
+  fflush (state->out);
+}
+
+static int
+index_files (struct lu_state_t *state, struct lu_watch_options_t *options, struct watch_index_t *index, char *dir)
+{
+  char *files = NULL;
+  size_t files_len = 0;
+  int err = lu_collect_files (dir, 1, &files, &files_len);
+  int changed = 0;
+  char *f = NULL;
+  while ((f = argz_next (files, files_len, f)))
+    changed |= update_file (state, options, index, f);
+  free (files);
+  return err ? -1 : changed;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static int
+ignore_dot_files (const struct dirent *entry)
+{
+  return entry->d_name[0] != '.';
+}
+
+//watch DIR and the directories in it, the same ones that
+//lu_collect_files looks in.
+static void
+watch_directory (struct watch_index_t *index, char *dir)
+{
+  int wd = inotify_add_watch (index->fd, dir,
+                              IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                              IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+  if (wd == -1)
+    {
+      error (0, errno, N_("could not watch `%s'"), dir);
+      return;
+    }
+  g_hash_table_replace (index->directories, GINT_TO_POINTER (wd),
+                        strdup (dir));
+  struct dirent **entries = NULL;
+  int n = scandir (dir, &entries, ignore_dot_files, alphasort);
+  for (int i = 0; i < n; i++)
+    {
+      char *f = xasprintf ("%s/%s", dir, entries[i]->d_name);
+      struct stat st;
+      if (lstat (f, &st) == 0 && S_ISDIR (st.st_mode))
+        watch_directory (index, f);
+      free (f);
+      free (entries[i]);
+    }
+  free (entries);
+}
+
+//stop watching DIR and the directories in it, when DIR has been moved
+//away.  if it was moved somewhere else in the tree, it's watched again
+//under its new name.
+static void
+unwatch_directory (struct watch_index_t *index, char *dir)
+{
+  char *prefix = xasprintf ("%s/", dir);
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init (&iter, index->directories);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    if (strcmp (value, dir) == 0 ||
+        strncmp (value, prefix, strlen (prefix)) == 0)
+      {
+        inotify_rm_watch (index->fd, GPOINTER_TO_INT (key));
+        g_hash_table_iter_remove (&iter);
+      }
+  free (prefix);
+}
+
+//some events were lost, so the whole tree is looked at again.
+static int
+look_again (struct lu_state_t *state, struct lu_watch_options_t *options, struct watch_index_t *index)
+{
+  char *gone = NULL;
+  size_t gone_len = 0;
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init (&iter, index->files);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      struct stat st;
+      if (lstat (key, &st) != 0 || !S_ISREG (st.st_mode))
+        argz_add (&gone, &gone_len, key);
+    }
+  int changed = 0;
+  char *f = NULL;
+  while ((f = argz_next (gone, gone_len, f)))
+    changed |= forget_file (state, index, f);
+  free (gone);
+  while ((f = argz_next (options->input_files, options->input_files_len, f)))
+    {
+      struct stat st;
+      if (stat (f, &st) == 0 && S_ISDIR (st.st_mode))
+        watch_directory (index, f);
+      changed |= index_files (state, options, index, f) > 0;
+    }
+  return changed;
+}
+
+static int
+handle_event (struct lu_state_t *state, struct lu_watch_options_t *options, struct watch_index_t *index, struct inotify_event *event)
+{
+  if (event->mask & IN_Q_OVERFLOW)
+    return look_again (state, options, index);
+  if (event->mask & IN_IGNORED)
+    {
+      g_hash_table_remove (index->directories, GINT_TO_POINTER (event->wd));
+      return 0;
+    }
+  char *dir = g_hash_table_lookup (index->directories,
+                                   GINT_TO_POINTER (event->wd));
+  if (!dir || event->len == 0 || event->name[0] == '.')
+    return 0;
+  char *file = xasprintf ("%s/%s", dir, event->name);
+  int changed = 0;
+  if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+    {
+      changed = forget_file (state, index, file);
+      if ((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM))
+        unwatch_directory (index, file);
+    }
+  else if (event->mask & IN_ISDIR)
+    {
+      if (event->mask & (IN_CREATE | IN_MOVED_TO))
+        {
+          watch_directory (index, file);
+          changed = index_files (state, options, index, file) > 0;
+        }
+    }
+  else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+    changed = update_file (state, options, index, file);
+  else if (event->mask & IN_CREATE)
+    {
+      //a file that is still being written is looked at when it's closed,
+      //but one that turns up all at once, like a hard link, never is.
+      struct stat st;
+      if (lstat (file, &st) == 0 && st.st_size > 0)
+        changed = update_file (state, options, index, file);
+    }
+  free (file);
+  return changed;
+}
+
+static int
+watch_for_changes (struct lu_state_t *state, struct lu_watch_options_t *options, struct watch_index_t *index)
+{
+  char buf[65536]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  while (1)
+    {
+      ssize_t n = read (index->fd, buf, sizeof (buf));
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        {
+          error (0, errno, N_("could not watch for changes"));
+          return -1;
+        }
+      int changed = 0;
+      struct inotify_event *event;
+      for (char *p = buf; p < buf + n; p += sizeof (*event) + event->len)
+        {
+          event = (struct inotify_event *) p;
+          changed |= handle_event (state, options, index, event);
+        }
+      if (changed)
+        show_summary (state, index);
+    }
+  return 0;
+}
+#endif
+
+int
+lu_watch (struct lu_state_t *state, struct lu_watch_options_t *options)
+{
+  int err = 0;
+  struct watch_index_t index;
+  index.files = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+                                       free_watched_file);
+  index.directories = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL, free);
+  index.fd = -1;
+  index.notices = NULL;
+  if (options->expected_licenses)
+    index.notices = lu_license_notices_new (state);
+#ifdef HAVE_SYS_INOTIFY_H
+  //the directories are watched before they're looked at, so that
+  //nothing that changes in the meantime is missed.
+  if (!options->once)
+    {
+      index.fd = inotify_init ();
+      if (index.fd == -1)
+        {
+          error (0, errno, N_("could not watch for changes"));
+          err = -1;
+        }
+    }
+#else
+  if (!options->once)
+    {
+      error (0, 0, N_("watching for changes isn't supported on this system"));
+      err = -1;
+    }
+#endif
+  char *f = NULL;
+  while (!err && (f = argz_next (options->input_files,
+                                 options->input_files_len, f)))
+    {
+#ifdef HAVE_SYS_INOTIFY_H
+      struct stat st;
+      if (index.fd != -1 && stat (f, &st) == 0 && S_ISDIR (st.st_mode))
+        watch_directory (&index, f);
+#endif
+      if (index_files (state, options, &index, f) == -1)
+        err = -1;
+    }
+  if (!err)
+    show_summary (state, &index);
+#ifdef HAVE_SYS_INOTIFY_H
+  if (!err && index.fd != -1)
+    err = watch_for_changes (state, options, &index);
+  if (index.fd != -1)
+    close (index.fd);
+#endif
+  if (index.notices)
+    lu_license_notices_free (index.notices);
+  g_hash_table_destroy (index.files);
+  g_hash_table_destroy (index.directories);
+  free (options->input_files);
+  free (options->expected_licenses);
+  return err;
+}
+
+struct lu_command_t watch =
+{
+  .name         = N_("watch"),
+  .doc          = WATCH_DOC,
+  .flags        = SHOW_IN_HELP | SAVE_IN_HISTORY,
+  .argp         = &argp,
+  .parser       = lu_watch_parse_argp
+};
@@ -0,0 +1,35 @@
+# Copyright (C) 2016 Ben Asselstine
+# 
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+#these tests feed the comment regexes files that used to make them
+#backtrack for a long time, or give up part way through a long comment.
+#a command that takes longer than LU_TEST_TIME_LIMIT seconds is stopped,
+#and that makes the test fail.
+limit=${LU_TEST_TIME_LIMIT-10}
+
+#run a command with its output going to OUT, or say it took too long.
+within_limit ()
+{
+  out=$1
+  shift
+  "$@" > $out 2>/dev/null &
+  pid=$!
+  (sleep $limit && kill $pid) > /dev/null 2>&1 &
+  watchdog=$!
+  wait $pid
+  status=$?
+  kill $watchdog > /dev/null 2>&1
+  if test $status -gt 128; then
+    echo "$2 $3 was stopped after $limit seconds"
+  fi
+}
+
+#how many bytes are in FILE.
+size ()
+{
+  wc -c < $1 | tr -d ' '
+}